@@ -42,10 +42,20 @@ class Box : public Object
 	double get_width()	const { return _w; }
 	double get_height()	const { return _h; }
 
+	/// Resize the geom, but not the mass of the body (meant for static boxes):
+	void set_size( double l, double w, double h )
+	{
+		_l = l;
+		_w = w;
+		_h = h;
+		if ( ! _geoms.empty() )
+			dGeomBoxSetLengths( _geoms[0], l, w, h );
+	}
+
 	/// const visitor
 	virtual void accept( ConstVisitor &v ) const
 	{
-		assert( _body );
+		assert( _body || _static );
 		v.visit( *this );
 	}
 
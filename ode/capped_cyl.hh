@@ -42,7 +42,7 @@ class CappedCyl : public Object
 	/// const visitor
 	virtual void accept( ConstVisitor &v ) const
 	{
-		assert( _body );
+		assert( _body || _static );
 		v.visit( *this );
 	}
 
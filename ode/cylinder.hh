@@ -41,10 +41,19 @@ class Cylinder : public Object
 	double get_radius()	  const { return _radius;   }
 	double get_length() const { return _length; }
 
+	/// Resize the geom, but not the mass of the body (meant for static cylinders):
+	void set_size( double radius, double length )
+	{
+		_radius = radius;
+		_length = length;
+		if ( ! _geoms.empty() )
+			dGeomCylinderSetParams( _geoms[0], radius, length );
+	}
+
 	/// const visitor
 	virtual void accept( ConstVisitor &v ) const
 	{
-		assert( _body );
+		assert( _body || _static );
 		v.visit( *this );
 	}
 
@@ -17,6 +17,9 @@
 */
 
 #include <Eigen/Geometry>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 #include "environment.hh"
 #include "object.hh"
@@ -26,14 +29,59 @@ namespace ode
 {
 
 
+  const contact_type Environment::_contact_table[3][3] = { { HARD,     SOFT,     DISABLED },
+                                                           { SOFT,     SOFT,     DISABLED },
+                                                           { DISABLED, DISABLED, DISABLED } };
+
+
   void Environment::_init(bool add_ground, double _angle)
   {
+	_collision_groups.push_back( "" );
+	_stepper = WORLD_STEP;
+	_threading = 0;
+	_thread_pool = 0;
+	_n_step_threads = 1;
+	_contact_count = 0;
+	_max_contact_depth = 0;
+	for ( int i = 0 ; i < dGeomNumClasses ; i++ )
+		_class_budget[i] = DEFAULT_CONTACT_BUDGET;
+	_merge_distance = 0;
+	_dt = time_step;
+	_n_contact_events = 0;
+	_dropped_contact_events = 0;
+	_contact_feedback = false;
+	_next_listener_id = 0;
+	_profiling = false;
+	_profile = collision_profile_t();
+	_material_table = Material_table::ptr_t( new Material_table( surface_t( _mu ) ) );
+
      //create world
     _world_id = dWorldCreate();
      //init gravity
     dWorldSetGravity(_world_id, 0, 0, -cst::g);
      //space
-    _space_id = dHashSpaceCreate(0);
+	switch ( _space_config.type )
+	{
+		case HASH_SPACE :
+			_space_id = dHashSpaceCreate( 0 );
+			dHashSpaceSetLevels( _space_id, _space_config.hash_min_level, _space_config.hash_max_level );
+			break;
+		case SAP_SPACE :
+			_space_id = dSweepAndPruneSpaceCreate( 0, _space_config.axis_order );
+			break;
+		case QUADTREE_SPACE :
+		{
+			dVector3 center = { _space_config.center.x(), _space_config.center.y(), _space_config.center.z(), 0 };
+			dVector3 extents = { _space_config.extents.x(), _space_config.extents.y(), _space_config.extents.z(), 0 };
+			_space_id = dQuadTreeSpaceCreate( 0, center, extents, _space_config.depth );
+			break;
+		}
+		case SIMPLE_SPACE :
+			_space_id = dSimpleSpaceCreate( 0 );
+			break;
+		default :
+			throw std::runtime_error( "Unknown type of collision space" );
+	}
      //ground
     if (add_ground)
     {
@@ -44,7 +92,8 @@ namespace ode
       q2 = Eigen::AngleAxis<double>(_roll, Eigen::Vector3d::UnitY());
       normal = q2 * q1 * normal;
       _ground = dCreatePlane(_space_id, normal.x(), normal.y(), normal.z(), _z);
-		dGeomSetData( _ground, new collision_feature( "ground" ) );
+		dGeomSetData( _ground, new collision_feature( get_collision_group_id( "ground" ) ) );
+		set_collision_bits( _ground );
     }
      //contact group1
     _contactgroup = dJointGroupCreate(0);
@@ -53,73 +102,326 @@ namespace ode
 
     //dWorldSetContactSurfaceLayer(_world_id, 0.001);
   }
-  void Environment::_collision(dGeomID o1, dGeomID o2)
+  void Environment::_add_object( Object* object )
   {
-	contact_type type = HARD;
+	_objects.push_back( object );
+  }
 
-	collision_feature* o1_collision_feature = (collision_feature*) dGeomGetData( o1 );
-	collision_feature* o2_collision_feature = (collision_feature*) dGeomGetData( o2 );
 
-	if ( o1_collision_feature != NULL && o1_collision_feature->callback )
-		o1_collision_feature->callback( o2_collision_feature );
+  void Environment::_remove_object( Object* object )
+  {
+	_objects.erase( std::remove( _objects.begin(), _objects.end(), object ), _objects.end() );
+  }
 
-	if ( o2_collision_feature != NULL && o2_collision_feature->callback )
-		o2_collision_feature->callback( o1_collision_feature );
+
+  void Environment::save_state( snapshot_t& snapshot )
+  {
+	snapshot.bodies.resize( _objects.size() );
+	for ( int i = 0 ; i < _objects.size() ; i++ )
+	{
+		body_state_t& state = snapshot.bodies[i];
+		state.body = _objects[i]->get_body();
+
+		memcpy( state.pos, dBodyGetPosition( state.body ), sizeof( state.pos ) );
+		memcpy( state.lin_vel, dBodyGetLinearVel( state.body ), sizeof( state.lin_vel ) );
+		memcpy( state.ang_vel, dBodyGetAngularVel( state.body ), sizeof( state.ang_vel ) );
+		memcpy( state.force, dBodyGetForce( state.body ), sizeof( state.force ) );
+		memcpy( state.torque, dBodyGetTorque( state.body ), sizeof( state.torque ) );
+
+		// ODE normalises the quaternion when it is set. Look for a quaternion left unchanged by
+		// this normalisation so that restoring it gives back exactly the same bits:
+		memcpy( state.quat, dBodyGetQuaternion( state.body ), sizeof( state.quat ) );
+		for ( int j = 0 ; j < 4 ; j++ )
+		{
+			dBodySetQuaternion( state.body, state.quat );
+			if ( memcmp( state.quat, dBodyGetQuaternion( state.body ), sizeof( state.quat ) ) == 0 )
+				break;
+			memcpy( state.quat, dBodyGetQuaternion( state.body ), sizeof( state.quat ) );
+		}
+	}
+	snapshot.rand_seed = dRandGetSeed();
+
+	// Go through the same restoration as any later fork, so that the geoms are ordered
+	// identically in the collision space:
+	restore_state( snapshot );
+  }
+
+
+  void Environment::restore_state( const snapshot_t& snapshot )
+  {
+	if ( snapshot.bodies.size() != _objects.size() )
+		throw std::runtime_error( "The objects of the environment have changed since the snapshot was taken" );
+
+	for ( const body_state_t& state : snapshot.bodies )
+	{
+		dBodySetPosition( state.body, state.pos[0], state.pos[1], state.pos[2] );
+		dBodySetQuaternion( state.body, state.quat );
+		dBodySetLinearVel( state.body, state.lin_vel[0], state.lin_vel[1], state.lin_vel[2] );
+		dBodySetAngularVel( state.body, state.ang_vel[0], state.ang_vel[1], state.ang_vel[2] );
+		dBodySetForce( state.body, state.force[0], state.force[1], state.force[2] );
+		dBodySetTorque( state.body, state.torque[0], state.torque[1], state.torque[2] );
+	}
+	dRandSetSeed( snapshot.rand_seed );
+
+	dJointGroupEmpty( _contactgroup );
+	_n_contact_events = 0;
+  }
 
 
-	if ( o1_collision_feature == NULL && o2_collision_feature == NULL )
+  void Environment::set_step_threads( unsigned int n_threads )
+  {
+	_free_step_threads();
+
+	if ( n_threads <= 1 )
 		return;
-	else if ( o1_collision_feature != NULL && o2_collision_feature != NULL )
+
+	_threading = dThreadingAllocateMultiThreadedImplementation();
+	if ( ! _threading )
+		throw std::runtime_error( "Failed to allocate the ODE threading implementation, ODE must be built with --enable-builtin-threading-impl" );
+	_thread_pool = dThreadingAllocateThreadPool( n_threads, 0, dAllocateFlagBasicData, NULL );
+	if ( ! _thread_pool )
 	{
-		if ( o1_collision_feature->type == DISABLED || o2_collision_feature->type == DISABLED )
-			return;
-		else if ( strcmp( o1_collision_feature->group, o2_collision_feature->group ) == 0 )
-			return;
-		else if ( o1_collision_feature->type == SOFT || o2_collision_feature->type == SOFT )
-			type = SOFT;
+		dThreadingFreeImplementation( _threading );
+		_threading = 0;
+		throw std::runtime_error( "Failed to allocate the ODE thread pool" );
 	}
-	else if ( o1_collision_feature != NULL )
+	dThreadingThreadPoolServeMultiThreadedImplementation( _thread_pool, _threading );
+	dWorldSetStepThreadingImplementation( _world_id, dThreadingImplementationGetFunctions( _threading ), _threading );
+	dWorldSetStepIslandsProcessingMaxThreadCount( _world_id, n_threads );
+	_n_step_threads = n_threads;
+  }
+
+
+  void Environment::_free_step_threads()
+  {
+	if ( ! _threading )
+		return;
+
+	dThreadingImplementationShutdownProcessing( _threading );
+	dThreadingFreeThreadPool( _thread_pool );
+	dWorldSetStepThreadingImplementation( _world_id, NULL, NULL );
+	dThreadingFreeImplementation( _threading );
+	_threading = 0;
+	_thread_pool = 0;
+	_n_step_threads = 1;
+  }
+
+
+  int Environment::get_collision_group_id( const char* group )
+  {
+	for ( int id = 0 ; id < _collision_groups.size() ; id++ )
+		if ( _collision_groups[id] == group )
+			return id;
+
+	if ( _collision_groups.size() >= sizeof( unsigned long )*8 )
+		throw std::runtime_error( std::string( "Too many collision groups to register " ) + std::string( group ) );
+
+	_collision_groups.push_back( group );
+	return _collision_groups.size() - 1;
+  }
+
+
+  const char* Environment::get_collision_group_name( int id ) const
+  {
+	return _collision_groups[id].c_str();
+  }
+
+
+  void Environment::set_collision_bits( dGeomID geom ) const
+  {
+	collision_feature* feature = ( collision_feature* ) dGeomGetData( geom );
+	if ( feature != NULL && feature->type == DISABLED )
 	{
-		if ( *o1_collision_feature->group == '\0' )
-			return;
-		else if ( o1_collision_feature->type == DISABLED )
-			return;
-		else if ( o1_collision_feature->type == SOFT )
-			type = SOFT;
+		dGeomSetCategoryBits( geom, 0 );
+		dGeomSetCollideBits( geom, 0 );
 	}
 	else
 	{
-		if ( *o2_collision_feature->group == '\0' )
-			return;
-		else if ( o2_collision_feature->type == DISABLED )
+		unsigned long category = 1ul << ( feature != NULL ? feature->group : 0 );
+		dGeomSetCategoryBits( geom, category );
+		dGeomSetCollideBits( geom, ~category );
+	}
+  }
+
+
+  void Environment::set_contact_budget( int geom_class, int max_contacts )
+  {
+	if ( geom_class < 0 || geom_class >= dGeomNumClasses )
+		throw std::runtime_error( "Invalid geom class for the contact budget" );
+	_class_budget[geom_class] = std::min( std::max( 1, max_contacts ), MAX_CONTACTS_PER_PAIR );
+  }
+
+
+  void Environment::set_contact_budget( const char* group_1, const char* group_2, int max_contacts )
+  {
+	static const int n_groups = sizeof( unsigned long )*8;
+	if ( _group_budget.empty() )
+		_group_budget.resize( n_groups*n_groups, -1 );
+
+	int id_1 = get_collision_group_id( group_1 );
+	int id_2 = get_collision_group_id( group_2 );
+	max_contacts = std::min( std::max( 1, max_contacts ), MAX_CONTACTS_PER_PAIR );
+	_group_budget[id_1*n_groups + id_2] = max_contacts;
+	_group_budget[id_2*n_groups + id_1] = max_contacts;
+  }
+
+
+  void Environment::set_material_table( Material_table::ptr_t table )
+  {
+	if ( ! table )
+		throw std::runtime_error( "Null material table" );
+	_material_table = table;
+  }
+
+
+  void Environment::set_contact_events( int capacity, bool feedback )
+  {
+	_contact_events.clear();
+	_contact_events.shrink_to_fit();
+	_contact_events.resize( std::max( 0, capacity ) );
+	_n_contact_events = 0;
+	_dropped_contact_events = 0;
+	_contact_feedback = feedback;
+  }
+
+
+  int Environment::add_contact_listener( contact_listener_t listener )
+  {
+	if ( _contact_events.empty() )
+		set_contact_events( DEFAULT_CONTACT_EVENT_CAPACITY, _contact_feedback );
+
+	_contact_listeners.push_back( std::make_pair( _next_listener_id, listener ) );
+	return _next_listener_id++;
+  }
+
+
+  void Environment::remove_contact_listener( int id )
+  {
+	for ( auto it = _contact_listeners.begin() ; it != _contact_listeners.end() ; it++ )
+		if ( it->first == id )
+		{
+			_contact_listeners.erase( it );
 			return;
-		else if ( o2_collision_feature->type == SOFT )
-			type = SOFT;
+		}
+  }
+
+
+  int Environment::_merge_contacts( dContact* contact, int n ) const
+  {
+	double squared_distance = _merge_distance*_merge_distance;
+	int n_kept = 0;
+	for ( int i = 0 ; i < n ; i++ )
+	{
+		int j = 0;
+		for ( ; j < n_kept ; j++ )
+		{
+			const dReal* a = contact[i].geom.pos;
+			const dReal* b = contact[j].geom.pos;
+			if ( ( a[0] - b[0] )*( a[0] - b[0] ) + ( a[1] - b[1] )*( a[1] - b[1] ) + ( a[2] - b[2] )*( a[2] - b[2] ) < squared_distance )
+				break;
+		}
+		if ( j == n_kept )
+			contact[n_kept++] = contact[i];
+		else if ( contact[i].geom.depth > contact[j].geom.depth )
+			contact[j] = contact[i];
 	}
+	return n_kept;
+  }
+
+
+  void Environment::_collision(dGeomID o1, dGeomID o2)
+  {
+	collision_feature* o1_collision_feature = (collision_feature*) dGeomGetData( o1 );
+	collision_feature* o2_collision_feature = (collision_feature*) dGeomGetData( o2 );
+
+	if ( o1_collision_feature != NULL && o1_collision_feature->callback )
+		o1_collision_feature->callback( o2_collision_feature );
+
+	if ( o2_collision_feature != NULL && o2_collision_feature->callback )
+		o2_collision_feature->callback( o1_collision_feature );
+
+	// Pairs of the same group or with a disabled geom are already rejected by the broadphase through the
+	// category and collide bits, except when a geom has been created without going through set_collision_bits:
+	int group_1 = ( o1_collision_feature != NULL ? o1_collision_feature->group : 0 );
+	int group_2 = ( o2_collision_feature != NULL ? o2_collision_feature->group : 0 );
+	if ( group_1 == group_2 )
+		return;
+
+	contact_type type = _contact_table[o1_collision_feature != NULL ? o1_collision_feature->type : HARD]
+	                                  [o2_collision_feature != NULL ? o2_collision_feature->type : HARD];
+	if ( type == DISABLED )
+		return;
 		
 
-    static const int N = 10;
+	int max_contacts = std::min( _class_budget[dGeomGetClass( o1 )], _class_budget[dGeomGetClass( o2 )] );
+	if ( ! _group_budget.empty() && _group_budget[group_1*sizeof( unsigned long )*8 + group_2] > 0 )
+		max_contacts = _group_budget[group_1*sizeof( unsigned long )*8 + group_2];
+
     int i, n;
-    dContact contact[N];
-    n = dCollide(o1, o2, N, &contact[0].geom, sizeof(dContact));
+    dContact contact[MAX_CONTACTS_PER_PAIR];
+	if ( _profiling )
+	{
+		auto start = std::chrono::steady_clock::now();
+		n = dCollide( o1, o2, max_contacts, &contact[0].geom, sizeof( dContact ) );
+		_profile.narrowphase_time += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+		_profile.pairs++;
+	}
+	else
+		n = dCollide(o1, o2, max_contacts, &contact[0].geom, sizeof(dContact));
+	if ( _merge_distance > 0 && n > 1 )
+		n = _merge_contacts( contact, n );
+
+	// Surface parameters of the pair of materials:
+	const surface_t& surface = _material_table->get_surface( o1_collision_feature != NULL ? o1_collision_feature->material : 0,
+	                                                         o2_collision_feature != NULL ? o2_collision_feature->material : 0 );
+	if ( surface.soft && type == HARD )
+		type = SOFT;
+
+	// Soft contact parameters:
+	double soft_erp( surface.soft_erp ), soft_cfm( surface.soft_cfm );
+	collision_feature* spring = ( o1_collision_feature != NULL && o1_collision_feature->kp > 0 ? o1_collision_feature :
+	                            ( o2_collision_feature != NULL && o2_collision_feature->kp > 0 ? o2_collision_feature : NULL ) );
+	if ( type == SOFT && spring != NULL && n > 0 )
+	{
+		// The spring-damper is shared between the n contacts:
+		double kp = spring->kp/n;
+		double kd = spring->kd/n;
+		soft_erp = _dt*kp/( _dt*kp + kd );
+		soft_cfm = 1/( _dt*kp + kd );
+	}
 
+    _contact_count += n;
     if (n > 0)
     {
       for (i = 0; i < n; i++)
       {
+		_max_contact_depth = std::max( _max_contact_depth, double( contact[i].geom.depth ) );
+
         contact[i].surface.mode = dContactApprox1;
         //contact[i].surface.mode = dContactApprox1 | dContactSlip1 | dContactSlip2;
-        contact[i].surface.mu = _mu;
+        contact[i].surface.mu = surface.mu;
         //contact[i].surface.slip1 = 0.5;
         //contact[i].surface.slip2 = 0.5;
+		if ( surface.slip > 0 )
+		{
+			contact[i].surface.mode |= dContactSlip1 | dContactSlip2;
+			contact[i].surface.slip1 = surface.slip;
+			contact[i].surface.slip2 = surface.slip;
+		}
+		if ( surface.bounce > 0 )
+		{
+			contact[i].surface.mode |= dContactBounce;
+			contact[i].surface.bounce = surface.bounce;
+			contact[i].surface.bounce_vel = surface.bounce_vel;
+		}
 
 		if ( type == SOFT )
 		{
 			contact[i].surface.mode |= dContactSoftCFM | dContactSoftERP;
 			//contact[i].surface.soft_cfm = 0.02;
 			//contact[i].surface.soft_erp = 0.5;
-			contact[i].surface.soft_cfm = 0.005;
-			contact[i].surface.soft_erp = 0.4;
+			contact[i].surface.soft_cfm = soft_cfm;
+			contact[i].surface.soft_erp = soft_erp;
 			//contact[i].surface.soft_cfm = 0.01;
 			//contact[i].surface.soft_erp = 0.8;
 		}
@@ -127,6 +429,28 @@ namespace ode
         dJointID c = dJointCreateContact( get_world(), get_contactgroup(), &contact[i] );
         dJointAttach( c, dGeomGetBody( contact[i].geom.g1 ), dGeomGetBody( contact[i].geom.g2 ) );
 
+		// Record the contact in the preallocated event buffer:
+		if ( _n_contact_events < _contact_events.size() )
+		{
+			contact_event_t& event = _contact_events[_n_contact_events++];
+			event.geom_1 = contact[i].geom.g1;
+			event.geom_2 = contact[i].geom.g2;
+			event.body_1 = dGeomGetBody( contact[i].geom.g1 );
+			event.body_2 = dGeomGetBody( contact[i].geom.g2 );
+			event.group_1 = ( contact[i].geom.g1 == o1 ? group_1 : group_2 );
+			event.group_2 = ( contact[i].geom.g1 == o1 ? group_2 : group_1 );
+			for ( int j = 0 ; j < 3 ; j++ )
+			{
+				event.pos[j] = contact[i].geom.pos[j];
+				event.normal[j] = contact[i].geom.normal[j];
+			}
+			event.depth = contact[i].geom.depth;
+			if ( _contact_feedback )
+				dJointSetFeedback( c, &event.feedback );
+		}
+		else if ( ! _contact_events.empty() )
+			_dropped_contact_events++;
+
 
         // grass
         // dBodyID obj = 0;
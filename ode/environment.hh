@@ -25,7 +25,12 @@
 #include <ode/ode.h>
 #include <ode/common.h>
 #include <set>
+#include <vector>
+#include <string>
+#include <functional>
+#include <chrono>
 #include "misc.hh"
+#include "material_table.hh"
 
 namespace ode
 {
@@ -38,23 +43,123 @@ namespace ode
 		DISABLED
 	} contact_type;
 
+	// Geoms of the same group never collide with each other. The group 0 gathers the geoms without any group.
+	// The group names are interned by Environment::get_collision_group_id.
+	// The callback is called for every pair of geoms found by the broadphase, before any contact test:
+	// use a contact listener (Environment::add_contact_listener) to react to actual contacts.
+	// The material indexes the surface parameters of the contacts in the material table of the environment.
+	// A SOFT geom with a positive stiffness kp (and damping kd) gets its contacts ERP and CFM computed from
+	// this spring-damper for the current timestep, shared between the contacts of each pair.
 	typedef struct collision_feature
 	{
-		const char* group;
+		int group;
 		contact_type type;
 		std::function<void(collision_feature*)> callback;
-		collision_feature( const char* arg ) : group( arg ) {}
-		collision_feature( contact_type arg ) : group( "\0" ), type( arg ) {}
-		collision_feature( std::function<void(collision_feature*)> arg ) : group( "\0" ), callback( arg ) {}
+		double kp, kd;
+		int material;
+		collision_feature( int arg ) : group( arg ), type( HARD ), kp( 0 ), kd( 0 ), material( 0 ) {}
+		collision_feature( contact_type arg ) : group( 0 ), type( arg ), kp( 0 ), kd( 0 ), material( 0 ) {}
+		collision_feature( std::function<void(collision_feature*)> arg ) : group( 0 ), type( HARD ), callback( arg ), kp( 0 ), kd( 0 ), material( 0 ) {}
 	} collision_feature;
 
 
+	// Broadphase used to find the candidate pairs of geoms:
+	typedef enum space_type_t
+	{
+		HASH_SPACE,
+		SAP_SPACE,
+		QUADTREE_SPACE,
+		SIMPLE_SPACE
+	} space_type_t;
+
+	typedef struct space_config_t
+	{
+		space_type_t type;
+		// Hash space: the cells sizes go from 2^hash_min_level to 2^hash_max_level.
+		int hash_min_level;
+		int hash_max_level;
+		// Quadtree space: region covered by the tree and its depth.
+		Eigen::Vector3d center;
+		Eigen::Vector3d extents;
+		int depth;
+		// Sweep and prune space: dSAP_AXES_XYZ, dSAP_AXES_XZY, etc.
+		int axis_order;
+		explicit space_config_t( space_type_t type = HASH_SPACE ) : type( type ), hash_min_level( -3 ), hash_max_level( 10 ),
+		                                                            center( 0, 0, 0 ), extents( 10, 10, 10 ), depth( 6 ),
+		                                                            axis_order( dSAP_AXES_XYZ ) {}
+	} space_config_t;
+
+
+	// Solver used to step the world:
+	typedef enum stepper_t
+	{
+		WORLD_STEP, // Exact solution of the LCP, cubic in the number of constraint rows
+		QUICK_STEP  // Iterative solver, linear in the number of constraint rows
+	} stepper_t;
+
+
+	// Size of the contact buffer of a pair of geoms:
+	#define MAX_CONTACTS_PER_PAIR 32
+	#define DEFAULT_CONTACT_BUDGET 10
+	// Capacity of the contact event buffer allocated when the first listener is added:
+	#define DEFAULT_CONTACT_EVENT_CAPACITY 512
+
+
+	// Contact actually generated by the narrowphase during the last step. The geom and body 1 are
+	// those the normal points to. The feedback holds the forces and torques applied by the contact
+	// joint on both bodies once the world has been stepped, if enabled in Environment::set_contact_events.
+	typedef struct contact_event_t
+	{
+		dGeomID geom_1, geom_2;
+		dBodyID body_1, body_2;
+		int group_1, group_2;
+		dReal pos[3];
+		dReal normal[3];
+		dReal depth;
+		dJointFeedback feedback;
+	} contact_event_t;
+
+	typedef std::function<void(const contact_event_t*,int)> contact_listener_t;
+
+
+	// Time spent by the environment since the last reset of the profile (in seconds). The time of the
+	// broadphase (dSpaceCollide) includes the narrowphase (dCollide) and the creation of the contact joints.
+	typedef struct collision_profile_t
+	{
+		double space_collide_time;
+		double narrowphase_time;
+		double step_time;
+		unsigned long pairs; // Pairs of geoms tested by the narrowphase
+		unsigned long contacts;
+		unsigned long steps;
+	} collision_profile_t;
+
+
   class Object;
    //singleton : only one env
   class Environment
   {
     public:
       static constexpr double time_step = 0.05;
+
+	// State of a body, saved with the exact bit patterns used by ODE:
+	typedef struct body_state_t
+	{
+		dBodyID body;
+		dReal pos[3];
+		dReal quat[4];
+		dReal lin_vel[3];
+		dReal ang_vel[3];
+		dReal force[3];
+		dReal torque[3];
+	} body_state_t;
+
+	typedef struct snapshot_t
+	{
+		std::vector<body_state_t> bodies;
+		unsigned long rand_seed;
+	} snapshot_t;
+
        // constructor
     Environment() :
         _ground(0x0), _pitch(0), _roll(0), _z(0), _mu(0.7)
@@ -94,6 +199,12 @@ namespace ode
         _init(add_ground);
       }
 
+	Environment( const space_config_t& space_config, bool add_ground = true, double mu = 0.7 ) :
+	             _ground( 0x0 ), _pitch( 0 ), _roll( 0 ), _z( 0 ), _mu( mu ), _space_config( space_config )
+	{
+		_init( add_ground );
+	}
+
      ~Environment()
       {
 
@@ -103,6 +214,7 @@ namespace ode
           dGeomDestroy(_ground);
 		}
         dSpaceDestroy(get_space());
+		_free_step_threads();
         dWorldDestroy(get_world());
         dJointGroupDestroy(_contactgroup);
       }
@@ -127,13 +239,51 @@ namespace ode
       void next_step(double dt = time_step)
       {
          //check collisions
-        dSpaceCollide(_space_id, (void *)this, &_near_callback);
+        collide(dt);
          //next step
-        dWorldStep(_world_id, dt);
-         //dWorldQuickStep(_world_id, dt);
-         // remove all contact joints
-        dJointGroupEmpty(_contactgroup);
+        integrate(dt);
       }
+	/// Create the contact joints for the current configuration of the world, before a step of dt.
+	void collide( double dt = time_step )
+	{
+		_dt = dt;
+		_contact_count = 0;
+		_n_contact_events = 0;
+		_dropped_contact_events = 0;
+		_max_contact_depth = 0;
+		if ( _profiling )
+		{
+			auto start = std::chrono::steady_clock::now();
+			dSpaceCollide( _space_id, (void *)this, &_near_callback );
+			_profile.space_collide_time += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+			_profile.contacts += _contact_count;
+		}
+		else
+			dSpaceCollide( _space_id, (void *)this, &_near_callback );
+	}
+	/// Number of contact joints created by the last collision detection and deepest penetration among them:
+	int get_contact_count() const { return _contact_count; }
+	double get_max_contact_depth() const { return _max_contact_depth; }
+	/// Step the world with the contact joints created by collide(), notify the contact listeners and remove the joints.
+	void integrate( double dt = time_step )
+	{
+		std::chrono::steady_clock::time_point start;
+		if ( _profiling )
+			start = std::chrono::steady_clock::now();
+		if ( _stepper == QUICK_STEP )
+			dWorldQuickStep(_world_id, dt);
+		else
+			dWorldStep(_world_id, dt);
+		if ( _profiling )
+		{
+			_profile.step_time += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+			_profile.steps++;
+		}
+		for ( const auto& listener : _contact_listeners )
+			listener.second( _contact_events.data(), _n_contact_events );
+		 // remove all contact joints
+		dJointGroupEmpty(_contactgroup);
+	}
       void disable_gravity()
       {
         dWorldSetGravity(_world_id, 0, 0, 0);
@@ -142,17 +292,93 @@ namespace ode
       {
         dWorldSetGravity(_world_id, x, y, z);
       }
+	/// iterations and sor (over-relaxation parameter) are only used by QUICK_STEP.
+	void set_stepper( stepper_t stepper, int iterations = 20, double sor = 1.3 )
+	{
+		_stepper = stepper;
+		dWorldSetQuickStepNumIterations( _world_id, iterations );
+		dWorldSetQuickStepW( _world_id, sor );
+	}
+	stepper_t get_stepper() const { return _stepper; }
+
+	/// Step the independent islands of bodies in parallel on a pool of n_threads threads owned by the
+	/// environment. n_threads <= 1 restores the single-threaded stepping. Collision detection stays
+	/// on the calling thread.
+	void set_step_threads( unsigned int n_threads );
+	unsigned int get_step_threads() const { return _n_step_threads; }
       double get_pitch() const { return _pitch; }
       double get_roll() const { return _roll; }
       double get_z() const { return _z; }
+
+	/// Save the state of every body of the world. The bodies are then reset to the saved state,
+	/// so that the current simulation and any later restoration continue identically, bit for bit.
+	void save_state( snapshot_t& snapshot );
+	/// The set of objects must be the same as when the snapshot was taken.
+	void restore_state( const snapshot_t& snapshot );
+
+	/// Integer ID of a collision group, registered at the first call.
+	int get_collision_group_id( const char* group );
+	const char* get_collision_group_name( int id ) const;
+	/// Update the ODE category and collide bits of a geom from its collision feature, so that the pairs
+	/// of geoms that can't collide are rejected by the broadphase.
+	void set_collision_bits( dGeomID geom ) const;
+
+	/// Maximal number of contacts generated between two geoms, according to their ODE classes (dSphereClass,
+	/// dBoxClass...): the budget of a pair is the smallest budget of the two classes (DEFAULT_CONTACT_BUDGET
+	/// by default), unless a budget is set for the pair of collision groups.
+	void set_contact_budget( int geom_class, int max_contacts );
+	void set_contact_budget( const char* group_1, const char* group_2, int max_contacts );
+	/// Keep only the deepest of the contacts of a pair closer than distance to each other (0 disables the merging).
+	void set_contact_merge_distance( double distance ) { _merge_distance = distance; }
+
+	/// Accumulate the time spent in the collision detection and in the stepping of the world (see
+	/// collision_profile_t). Enabling the profiling resets the profile.
+	void set_profiling( bool profiling ) { _profiling = profiling; reset_profile(); }
+	void reset_profile() { _profile = collision_profile_t(); }
+	const collision_profile_t& get_profile() const { return _profile; }
+
+	/// Surface parameters of the contacts by pair of materials. The default table is built from the friction
+	/// coefficient given to the constructor. The table can be swapped at any time between two steps, to change
+	/// the friction of the next episode for instance. The materials of the geoms are kept by ID (see Material_table).
+	Material_table::ptr_t get_material_table() const { return _material_table; }
+	void set_material_table( Material_table::ptr_t table );
+	/// Material ID registered in the current table.
+	int get_material_id( const char* material ) { return _material_table->get_material_id( material ); }
+
+	/// Record the contacts generated at each step in a buffer of the given capacity, allocated once (0 disables
+	/// the recording). The contacts beyond the capacity are still simulated but not recorded. With feedback,
+	/// the forces applied by each contact are recorded as well, at the cost of a copy per contact joint in ODE.
+	void set_contact_events( int capacity, bool feedback = false );
+	/// Contacts of the last step, valid until the next call to collide():
+	const contact_event_t* get_contact_events() const { return _contact_events.data(); }
+	int get_contact_event_count() const { return _n_contact_events; }
+	/// Number of contacts of the last step that didn't fit in the buffer:
+	int get_dropped_contact_events() const { return _dropped_contact_events; }
+	/// The listener is called after each step of the world with the contact events of the step. If the events
+	/// are not recorded yet, a buffer of DEFAULT_CONTACT_EVENT_CAPACITY events is allocated. Return an ID
+	/// to remove the listener.
+	int add_contact_listener( contact_listener_t listener );
+	void remove_contact_listener( int id );
+
     protected:
+	friend class Object;
+	void _add_object( Object* object );
+	void _remove_object( Object* object );
+
     void _init(bool add_ground,double angle=0);
       static void _near_callback(void *data, dGeomID o1, dGeomID o2)
       {
         Environment*env = reinterpret_cast<Environment *>(data);
-        env->_collision(o1, o2);
+		// Geoms gathered in a nested space (a robot for instance) are only tested against the geoms
+		// outside of this space:
+		if ( dGeomIsSpace( o1 ) || dGeomIsSpace( o2 ) )
+			dSpaceCollide2( o1, o2, data, &_near_callback );
+		else
+			env->_collision(o1, o2);
       }
       void _collision(dGeomID o1, dGeomID o2);
+	int _merge_contacts( dContact* contact, int n ) const;
+	void _free_step_threads();
     //public: // ??
        // attributes
       dWorldID _world_id;
@@ -162,6 +388,30 @@ namespace ode
       double _pitch, _roll, _z;
     double angle;
 	double _mu;
+	Material_table::ptr_t _material_table;
+	std::vector<Object*> _objects;
+	std::vector<std::string> _collision_groups;
+	space_config_t _space_config;
+	stepper_t _stepper;
+	dThreadingImplementationID _threading;
+	dThreadingThreadPoolID _thread_pool;
+	unsigned int _n_step_threads;
+	int _contact_count;
+	double _max_contact_depth;
+	int _class_budget[dGeomNumClasses];
+	// Budgets by pair of groups, indexed by group_1*64 + group_2 (empty when none is set):
+	std::vector<int> _group_budget;
+	double _merge_distance;
+	double _dt;
+	std::vector<contact_event_t> _contact_events;
+	int _n_contact_events;
+	int _dropped_contact_events;
+	bool _contact_feedback;
+	std::vector<std::pair<int,contact_listener_t>> _contact_listeners;
+	int _next_listener_id;
+	bool _profiling;
+	collision_profile_t _profile;
+	static const contact_type _contact_table[3][3];
   };
 }
 
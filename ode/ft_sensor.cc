@@ -23,7 +23,7 @@ using namespace Eigen;
 
 
 FT_sensor::FT_sensor( const Object* A, const Object* B, const Vector3d& center, const Vector3d& k_lin_diag, const Vector3d& k_ang_diag,
-	                                                                            const Vector3d& c_lin_diag, const Vector3d& c_ang_diag ) : _A( A->get_body() ), _B( B->get_body() )
+	                                                                            const Vector3d& c_lin_diag, const Vector3d& c_ang_diag ) : _A( A->get_body() ), _B( B->get_body() ), _extension_rate( 0 )
 {
 	_set_rel_center_pos( A, center, _oc_A );
 	_set_rel_center_pos( B, center, _oc_B );
@@ -35,7 +35,7 @@ FT_sensor::FT_sensor( const Object* A, const Object* B, const Vector3d& center,
 }
 
 
-FT_sensor::FT_sensor( const Object* A, const Object* B, const Vector3d& center, double k_lin, double k_ang, double c_lin, double c_ang ) : _A( A->get_body() ), _B( B->get_body() )
+FT_sensor::FT_sensor( const Object* A, const Object* B, const Vector3d& center, double k_lin, double k_ang, double c_lin, double c_ang ) : _A( A->get_body() ), _B( B->get_body() ), _extension_rate( 0 )
 {
 	_set_rel_center_pos( A, center, _oc_A );
 	_set_rel_center_pos( B, center, _oc_B );
@@ -69,6 +69,7 @@ void FT_sensor::Update()
 	Vector3d vel_B = ode_to_vectord( vec );
 
 	_F = _K_lin*( pos_B - pos_A ) + _C_lin*( vel_B - vel_A );
+	_extension_rate = ( vel_B - vel_A ).norm();
 
 
 	const dReal* qA = dBodyGetQuaternion( _A );
@@ -88,3 +89,108 @@ void FT_sensor::Update()
 }
 
 
+
+
+int FT_sensor_group::Add( const Object* A, const Object* B, const Vector3d& center, const Vector3d& k_lin_diag, const Vector3d& k_ang_diag,
+	                                                                           const Vector3d& c_lin_diag, const Vector3d& c_ang_diag )
+{
+	int i = _A.size();
+	int n = i + 1;
+
+	_A.push_back( A->get_body() );
+	_B.push_back( B->get_body() );
+	_body_A.push_back( _GetBodyIndex( A->get_body() ) );
+	_body_B.push_back( _GetBodyIndex( B->get_body() ) );
+
+	for ( Matrix3Xd* m : { &_oc_A, &_oc_B, &_k_lin, &_k_ang, &_c_lin, &_c_ang, &_r_A, &_r_B, &_dp, &_dv, &_rot, &_dw } )
+		m->conservativeResize( 3, n );
+	_body_forces.resize( 3, _bodies.size() );
+	_body_torques.resize( 3, _bodies.size() );
+	_torsors.conservativeResize( 6, n );
+	_torsors.col( i ).setZero();
+	_extension_rate.conservativeResize( n );
+	_extension_rate[i] = 0;
+
+	dVector3 vec;
+	dBodyGetPosRelPoint( _A[i], center.x(), center.y(), center.z(), vec );
+	_oc_A.col( i ) = Vector3d( vec[0], vec[1], vec[2] );
+	dBodyGetPosRelPoint( _B[i], center.x(), center.y(), center.z(), vec );
+	_oc_B.col( i ) = Vector3d( vec[0], vec[1], vec[2] );
+
+	_k_lin.col( i ) = k_lin_diag;
+	_k_ang.col( i ) = k_ang_diag;
+	_c_lin.col( i ) = c_lin_diag;
+	_c_ang.col( i ) = c_ang_diag;
+
+	return i;
+}
+
+
+int FT_sensor_group::Add( const Object* A, const Object* B, const Vector3d& center, double k_lin, double k_ang, double c_lin, double c_ang )
+{
+	return Add( A, B, center, Vector3d::Constant( k_lin ), Vector3d::Constant( k_ang ), Vector3d::Constant( c_lin ), Vector3d::Constant( c_ang ) );
+}
+
+
+int FT_sensor_group::_GetBodyIndex( dBodyID body )
+{
+	for ( int k = 0 ; k < _bodies.size() ; k++ )
+		if ( _bodies[k] == body )
+			return k;
+	_bodies.push_back( body );
+	return _bodies.size() - 1;
+}
+
+
+void FT_sensor_group::Update()
+{
+	typedef Map<const Matrix<dReal,3,4,RowMajor>> rotation_t;
+	typedef Map<const Matrix<dReal,3,1>> vector_t;
+
+	// Relative motion of the two bodies of each sensor, read directly from the bodies:
+	for ( int i = 0 ; i < _A.size() ; i++ )
+	{
+		_r_A.col( i ) = rotation_t( dBodyGetRotation( _A[i] ) ).leftCols<3>()*_oc_A.col( i );
+		_r_B.col( i ) = rotation_t( dBodyGetRotation( _B[i] ) ).leftCols<3>()*_oc_B.col( i );
+
+		_dp.col( i ) = ( vector_t( dBodyGetPosition( _B[i] ) ) + _r_B.col( i ) ) - ( vector_t( dBodyGetPosition( _A[i] ) ) + _r_A.col( i ) );
+
+		vector_t angvel_A( dBodyGetAngularVel( _A[i] ) );
+		vector_t angvel_B( dBodyGetAngularVel( _B[i] ) );
+		_dv.col( i ) = ( vector_t( dBodyGetLinearVel( _B[i] ) ) + angvel_B.cross( _r_B.col( i ) ) )
+		             - ( vector_t( dBodyGetLinearVel( _A[i] ) ) + angvel_A.cross( _r_A.col( i ) ) );
+		_dw.col( i ) = angvel_B - angvel_A;
+
+		// Rotation vector of the relative quaternion, with the rotation angle in [0,pi]:
+		const dReal* qA = dBodyGetQuaternion( _A[i] );
+		const dReal* qB = dBodyGetQuaternion( _B[i] );
+		Quaterniond rel_quat = Quaterniond( qB[0], qB[1], qB[2], qB[3] )*Quaterniond( qA[0], qA[1], qA[2], qA[3] ).conjugate();
+		double n = rel_quat.vec().norm();
+		double w = fabs( rel_quat.w() );
+		// 2*atan2( n, w )/n tends to 2/w for small angles, with a relative error of n^2/3:
+		double scale = ( n > 1e-8 ? 2*atan2( n, w )/n : 2/w );
+		_rot.col( i ) = ( rel_quat.w() < 0 ? -scale : scale )*rel_quat.vec();
+	}
+
+	_torsors.topRows<3>() = _k_lin.cwiseProduct( _dp ) + _c_lin.cwiseProduct( _dv );
+	_torsors.bottomRows<3>() = _k_ang.cwiseProduct( _rot ) + _c_ang.cwiseProduct( _dw );
+	_extension_rate = _dv.colwise().norm().transpose();
+
+	// Spring forces and torques, summed by body:
+	_body_forces.setZero();
+	_body_torques.setZero();
+	for ( int i = 0 ; i < _A.size() ; i++ )
+	{
+		Vector3d F = _torsors.block<3,1>( 0, i );
+		Vector3d T = _torsors.block<3,1>( 3, i );
+		_body_forces.col( _body_A[i] ) += F;
+		_body_torques.col( _body_A[i] ) += _r_A.col( i ).cross( F ) + T;
+		_body_forces.col( _body_B[i] ) -= F;
+		_body_torques.col( _body_B[i] ) -= _r_B.col( i ).cross( F ) + T;
+	}
+	for ( int k = 0 ; k < _bodies.size() ; k++ )
+	{
+		dBodyAddForce( _bodies[k], _body_forces( 0, k ), _body_forces( 1, k ), _body_forces( 2, k ) );
+		dBodyAddTorque( _bodies[k], _body_torques( 0, k ), _body_torques( 1, k ), _body_torques( 2, k ) );
+	}
+}
@@ -20,13 +20,14 @@
 #include "ode/object.hh"
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <vector>
 	
 
 class FT_sensor
 {
 	public:
 
-	FT_sensor() {}
+	FT_sensor() : _extension_rate( 0 ) {}
 	FT_sensor( const ode::Object* A, const ode::Object* B, const Eigen::Vector3d& center, const Eigen::Vector3d& k_lin_diag, const Eigen::Vector3d& k_ang_diag,
 	                                                                                      const Eigen::Vector3d& c_lin_diag, const Eigen::Vector3d& c_ang_diag );
 	FT_sensor( const ode::Object* A, const ode::Object* B, const Eigen::Vector3d& center, double k_lin, double k_ang, double c_lin, double c_ang );
@@ -35,6 +36,8 @@ class FT_sensor
 
 	inline const Eigen::Vector3d* GetForces()  const { return &_F; }
 	inline const Eigen::Vector3d* GetTorques() const { return &_T; }
+	/// Relative velocity of the two bodies at the center of the sensor:
+	inline double GetExtensionRate() const { return _extension_rate; }
 
 	protected:
 
@@ -44,6 +47,59 @@ class FT_sensor
 	Eigen::Vector3d _oc_A, _oc_B;
 	Eigen::Matrix3d _K_lin, _K_ang, _C_lin, _C_ang;
 	Eigen::Vector3d _F, _T;
+	double _extension_rate;
+};
+
+
+/// Compliant force-torque sensors of a world updated together. The parameters, the intermediate values and
+/// the outputs are stored by component over all the sensors. The rotation between the two bodies is taken
+/// as the logarithm of their relative quaternion instead of an AngleAxis conversion, and the forces and
+/// torques are summed by body before being applied once to each body. The stiffnesses and dampings are
+/// diagonal, as with both constructors of FT_sensor.
+class FT_sensor_group
+{
+	public:
+
+	typedef Eigen::Matrix<double,6,Eigen::Dynamic> torsors_t;
+
+	/// Add a sensor between A and B and return its index:
+	int Add( const ode::Object* A, const ode::Object* B, const Eigen::Vector3d& center, const Eigen::Vector3d& k_lin_diag, const Eigen::Vector3d& k_ang_diag,
+	                                                                                    const Eigen::Vector3d& c_lin_diag, const Eigen::Vector3d& c_ang_diag );
+	int Add( const ode::Object* A, const ode::Object* B, const Eigen::Vector3d& center, double k_lin, double k_ang, double c_lin, double c_ang );
+
+	void Update();
+
+	inline int GetSize() const { return _A.size(); }
+
+	/// One column per sensor, with the three components of the force followed by those of the torque.
+	/// The non-const access lets the outputs be post-processed in place (filtered for instance) until the
+	/// next update.
+	inline const torsors_t& GetTorsors() const { return _torsors; }
+	inline torsors_t& GetTorsors() { return _torsors; }
+	inline Eigen::Vector3d GetForces( int i ) const { return _torsors.block<3,1>( 0, i ); }
+	inline Eigen::Vector3d GetTorques( int i ) const { return _torsors.block<3,1>( 3, i ); }
+	/// Relative velocity of the two bodies at the center of the sensor:
+	inline double GetExtensionRate( int i ) const { return _extension_rate[i]; }
+
+	protected:
+
+	int _GetBodyIndex( dBodyID body );
+
+	std::vector<dBodyID> _A, _B;
+	// Indices of the bodies in _bodies:
+	std::vector<int> _body_A, _body_B;
+	std::vector<dBodyID> _bodies;
+
+	Eigen::Matrix3Xd _oc_A, _oc_B;
+	Eigen::Matrix3Xd _k_lin, _k_ang, _c_lin, _c_ang;
+
+	// Lever arms in the world frame, relative displacement, velocity, rotation and angular velocity:
+	Eigen::Matrix3Xd _r_A, _r_B, _dp, _dv, _rot, _dw;
+	// Forces and torques to apply to each body:
+	Eigen::Matrix3Xd _body_forces, _body_torques;
+
+	torsors_t _torsors;
+	Eigen::VectorXd _extension_rate;
 };
 
 
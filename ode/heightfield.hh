@@ -19,7 +19,7 @@
 
 #include <iostream>
 #include "object.hh"
-#include <osgDB/ReadFile>
+#include "heightmap.hh"
 
 
 namespace ode
@@ -39,25 +39,34 @@ class HeightField : public Object
 		init();
 	}
 
-	HeightField( Environment& env , const Eigen::Vector3d& pos, const char* heightimage_path, int z_scale,
+	/// The greyscale image is converted once to a heightmap file cached next to it (see Heightmap::load_image),
+	/// the white pixels being at z_scale metres.
+	HeightField( Environment& env , const Eigen::Vector3d& pos, const char* heightimage_path, double z_scale,
 	double l, double w, double skirt_height = 0, double bound_min = -dInfinity, double bound_max = dInfinity, bool casts_shadow = false ) :
-	Object( env, pos ), length( l ), width( w ), skirt( skirt_height ), min( bound_min ), max( bound_max ), texture_path( nullptr )
+	HeightField( env, pos, Heightmap::load_image( heightimage_path, z_scale ), l, w, skirt_height, bound_min, bound_max, casts_shadow ) {}
+
+	/// The samples of the heightmap are used by ODE without any copy.
+	HeightField( Environment& env , const Eigen::Vector3d& pos, Heightmap::ptr_t heightmap,
+	double l, double w, double skirt_height = 0, double bound_min = -dInfinity, double bound_max = dInfinity, bool casts_shadow = false ) :
+	Object( env, pos ), data( nullptr ), nrow( heightmap->get_rows() ), ncol( heightmap->get_cols() ), length( l ), width( w ), skirt( skirt_height ), min( bound_min ), max( bound_max ), texture_path( nullptr ),
+	_heightmap( heightmap )
 	{
-		osg::Image* heightimage = osgDB::readImageFile( heightimage_path );
-		if ( heightimage == nullptr )
-			throw std::runtime_error( std::string( "Can't open " ) + std::string( heightimage_path ) );
-		nrow = heightimage->t();
-		ncol = heightimage->s();
-		data = (double*) calloc( nrow*ncol, sizeof( double ) );
-		for ( int r = 0 ; r < nrow ; r++ )
-			for ( int c = 0 ; c < ncol ; c++ )
-				data[(nrow-r-1)*ncol+c] = ( *heightimage->data( c, r ) )*0.3/255;
-
-		data_alloc = true;
+		data_alloc = false;
 		_casts_shadow = casts_shadow;
 		init();
 	}
 
+	/// Height of a sample, the row 0 being at the highest y and the column 0 at the lowest x:
+	inline double get_height( int row, int col ) const
+	{
+		if ( _heightmap )
+			return _heightmap->get_height( row, col );
+		else
+			return data[row*ncol + col];
+	}
+
+	inline Heightmap::ptr_t get_heightmap() const { return _heightmap; }
+
 	void set_texture( const char* const path_to_texture )
 	{
 		texture_path = path_to_texture;
@@ -71,6 +80,14 @@ class HeightField : public Object
 
 	virtual ~HeightField()
 	{
+		// The geom is destroyed before the heightfield data it refers to:
+		for ( dGeomID g : _geoms )
+		{
+			delete ( collision_feature* ) dGeomGetData( g );
+			dGeomDestroy( g );
+		}
+		_geoms.clear();
+		dGeomHeightfieldDataDestroy( _id );
 		if ( data_alloc )
 			free( data );
 	}
@@ -91,7 +108,13 @@ class HeightField : public Object
 	void init()
 	{
 		_id = dGeomHeightfieldDataCreate();
-		dGeomHeightfieldDataBuildDouble( _id, data, 0, length, width, ncol, nrow, 1, 0, skirt, 0 );
+		if ( ! _heightmap )
+			dGeomHeightfieldDataBuildDouble( _id, data, 0, length, width, ncol, nrow, 1, 0, skirt, 0 );
+		else if ( _heightmap->get_sample_type() == FLOAT_SAMPLES )
+			dGeomHeightfieldDataBuildSingle( _id, ( const float* ) _heightmap->get_samples(), 0, length, width, ncol, nrow, 1, 0, skirt, 0 );
+		else
+			dGeomHeightfieldDataBuildShort( _id, ( const short* ) _heightmap->get_samples(), 0, length, width, ncol, nrow,
+			                                _heightmap->get_scale(), _heightmap->get_offset(), skirt, 0 );
 		dGeomHeightfieldDataSetBounds( _id, min, max );
 		dGeomID g = dCreateHeightfield( _env.get_space(), _id, 1 );
 
@@ -100,6 +123,7 @@ class HeightField : public Object
 		dRSetIdentity( R );
 		dRFromAxisAndAngle( R, 1, 0, 0, 1.5707963267948966 );
 		dGeomSetRotation( g, R );
+		_env.set_collision_bits( g );
 
 		_geoms.push_back( g );
 	}
@@ -107,6 +131,7 @@ class HeightField : public Object
 
 	dHeightfieldDataID _id;
 	bool data_alloc;
+	Heightmap::ptr_t _heightmap;
 };
 
 
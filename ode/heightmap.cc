@@ -0,0 +1,202 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ode/heightmap.hh"
+#include <osgDB/ReadFile>
+#include <boost/weak_ptr.hpp>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace ode
+{
+
+
+// Heightmaps currently mapped, with the modification time and size of their file when they were mapped:
+typedef struct registry_entry_t
+{
+	boost::weak_ptr<Heightmap> heightmap;
+	struct timespec mtime;
+	off_t size;
+} registry_entry_t;
+
+static std::mutex _registry_mutex;
+static std::map<std::string,registry_entry_t> _registry;
+static std::mutex _conversion_mutex;
+
+
+Heightmap::ptr_t Heightmap::load( const std::string& path )
+{
+	struct stat file_stat;
+	if ( stat( path.c_str(), &file_stat ) != 0 )
+		throw std::runtime_error( std::string( "Can't open " ) + path );
+
+	std::lock_guard<std::mutex> lock( _registry_mutex );
+
+	auto it = _registry.find( path );
+	if ( it != _registry.end() )
+	{
+		ptr_t heightmap = it->second.heightmap.lock();
+		if ( heightmap && it->second.size == file_stat.st_size
+		               && it->second.mtime.tv_sec == file_stat.st_mtim.tv_sec
+		               && it->second.mtime.tv_nsec == file_stat.st_mtim.tv_nsec )
+			return heightmap;
+	}
+
+	ptr_t heightmap( new Heightmap( path ) );
+	_registry[path] = { heightmap, file_stat.st_mtim, file_stat.st_size };
+
+	return heightmap;
+}
+
+
+Heightmap::ptr_t Heightmap::load_image( const std::string& image_path, double z_scale, sample_type_t sample_type )
+{
+	std::string cache_path = image_path + HEIGHTMAP_EXTENSION;
+
+	std::lock_guard<std::mutex> lock( _conversion_mutex );
+
+	struct stat image_stat, cache_stat;
+	if ( stat( image_path.c_str(), &image_stat ) != 0 )
+		throw std::runtime_error( std::string( "Can't open " ) + image_path );
+
+	if ( stat( cache_path.c_str(), &cache_stat ) == 0 && cache_stat.st_mtime >= image_stat.st_mtime )
+	{
+		ptr_t heightmap = load( cache_path );
+		if ( heightmap->get_source_z_scale() == z_scale && heightmap->get_sample_type() == sample_type )
+			return heightmap;
+	}
+
+	convert_image( image_path, z_scale, sample_type, cache_path );
+
+	return load( cache_path );
+}
+
+
+void Heightmap::convert_image( const std::string& image_path, double z_scale, sample_type_t sample_type, const std::string& output_path )
+{
+	osg::ref_ptr<osg::Image> image = osgDB::readImageFile( image_path );
+	if ( ! image )
+		throw std::runtime_error( std::string( "Can't open " ) + image_path );
+
+	heightmap_header_t header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, HEIGHTMAP_MAGIC, sizeof( header.magic ) );
+	header.sample_type = sample_type;
+	header.n_rows = image->t();
+	header.n_cols = image->s();
+	header.source_z_scale = z_scale;
+	// The int16 samples cover [0, z_scale]:
+	header.scale = ( sample_type == FLOAT_SAMPLES ? 1 : z_scale/32767 );
+	header.offset = 0;
+
+	// Intensity of the first channel of the pixels, in [0, 1]:
+	double max_value = ( image->getDataType() == GL_UNSIGNED_SHORT ? 65535 : 255 );
+	auto intensity = [&image,max_value]( int c, int r ) -> double
+	{
+		if ( image->getDataType() == GL_UNSIGNED_SHORT )
+			return *( ( const unsigned short* ) image->data( c, r ) )/max_value;
+		else
+			return *image->data( c, r )/max_value;
+	};
+
+	size_t n_samples = size_t( header.n_rows )*header.n_cols;
+	std::vector<float> float_samples;
+	std::vector<int16_t> int16_samples;
+	if ( sample_type == FLOAT_SAMPLES )
+		float_samples.resize( n_samples );
+	else
+		int16_samples.resize( n_samples );
+
+	// The image rows go downwards:
+	for ( int r = 0 ; r < header.n_rows ; r++ )
+		for ( int c = 0 ; c < header.n_cols ; c++ )
+		{
+			size_t index = size_t( header.n_rows - r - 1 )*header.n_cols + c;
+			if ( sample_type == FLOAT_SAMPLES )
+				float_samples[index] = intensity( c, r )*z_scale;
+			else
+				int16_samples[index] = int16_t( lround( intensity( c, r )*32767 ) );
+		}
+
+	// Write a temporary file and move it in place, so that the heightmaps already mapped remain valid:
+	std::string tmp_path = output_path + ".tmp";
+	FILE* file = fopen( tmp_path.c_str(), "wb" );
+	if ( file == nullptr )
+		throw std::runtime_error( std::string( "Can't write " ) + tmp_path );
+	bool written = ( fwrite( &header, sizeof( header ), 1, file ) == 1 );
+	if ( sample_type == FLOAT_SAMPLES )
+		written = written && ( fwrite( float_samples.data(), sizeof( float ), n_samples, file ) == n_samples );
+	else
+		written = written && ( fwrite( int16_samples.data(), sizeof( int16_t ), n_samples, file ) == n_samples );
+	written = ( fclose( file ) == 0 ) && written;
+	if ( ! written || rename( tmp_path.c_str(), output_path.c_str() ) != 0 )
+	{
+		remove( tmp_path.c_str() );
+		throw std::runtime_error( std::string( "Can't write " ) + output_path );
+	}
+}
+
+
+Heightmap::Heightmap( const std::string& path ) : _header( nullptr ), _samples( nullptr ), _mapping( nullptr ), _mapping_size( 0 )
+{
+	int fd = open( path.c_str(), O_RDONLY );
+	if ( fd < 0 )
+		throw std::runtime_error( std::string( "Can't open " ) + path );
+
+	struct stat file_stat;
+	if ( fstat( fd, &file_stat ) != 0 || file_stat.st_size < sizeof( heightmap_header_t ) )
+	{
+		close( fd );
+		throw std::runtime_error( std::string( "Invalid heightmap file " ) + path );
+	}
+
+	_mapping_size = file_stat.st_size;
+	_mapping = mmap( nullptr, _mapping_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( _mapping == MAP_FAILED )
+		throw std::runtime_error( std::string( "Can't map " ) + path );
+
+	_header = ( const heightmap_header_t* ) _mapping;
+	_samples = ( const char* ) _mapping + sizeof( heightmap_header_t );
+
+	size_t sample_size = ( _header->sample_type == FLOAT_SAMPLES ? sizeof( float ) : sizeof( int16_t ) );
+	if ( memcmp( _header->magic, HEIGHTMAP_MAGIC, sizeof( _header->magic ) ) != 0
+	     || _header->sample_type > INT16_SAMPLES
+	     || _mapping_size < sizeof( heightmap_header_t ) + size_t( _header->n_rows )*_header->n_cols*sample_size )
+	{
+		munmap( _mapping, _mapping_size );
+		throw std::runtime_error( std::string( "Invalid heightmap file " ) + path );
+	}
+}
+
+
+Heightmap::~Heightmap()
+{
+	munmap( _mapping, _mapping_size );
+}
+
+
+}
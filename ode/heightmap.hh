@@ -0,0 +1,108 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HEIGHTMAP_HH
+#define HEIGHTMAP_HH
+
+#include <string>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+
+
+namespace ode
+{
+
+
+// Storage of the heights in a heightmap file:
+typedef enum sample_type_t
+{
+	FLOAT_SAMPLES, // Heights in metres
+	INT16_SAMPLES  // Heights given by offset + scale*sample
+} sample_type_t;
+
+
+// Header of a heightmap file, followed by the n_rows*n_cols samples, row by row, in the byte order of the
+// machine that wrote it. The row 0 is the one of the highest y of the ode::HeightField.
+typedef struct heightmap_header_t
+{
+	char magic[8];
+	uint32_t sample_type;
+	uint32_t n_rows;
+	uint32_t n_cols;
+	uint32_t padding;
+	double scale;
+	double offset;
+	// Vertical scale requested when the file was converted from an image:
+	double source_z_scale;
+	char reserved[16];
+} heightmap_header_t;
+
+#define HEIGHTMAP_MAGIC "HMAP0001"
+#define HEIGHTMAP_EXTENSION ".hmap"
+
+
+/// Read-only heightmap memory-mapped from a binary file. The heightmaps are shared: loading a file already
+/// mapped by another environment returns the same object, as long as the file hasn't changed.
+class Heightmap
+{
+	public:
+
+	typedef boost::shared_ptr<Heightmap> ptr_t;
+
+	/// Map a heightmap file.
+	static ptr_t load( const std::string& path );
+
+	/// Map the heightmap file cached next to an image (image_path + HEIGHTMAP_EXTENSION), after having
+	/// converted the image if the cache is missing, older than the image or made with another z_scale.
+	static ptr_t load_image( const std::string& image_path, double z_scale, sample_type_t sample_type = INT16_SAMPLES );
+
+	/// Convert a greyscale image to a heightmap file, the white pixels being at z_scale metres.
+	static void convert_image( const std::string& image_path, double z_scale, sample_type_t sample_type, const std::string& output_path );
+
+	~Heightmap();
+
+	inline int get_rows() const { return _header->n_rows; }
+	inline int get_cols() const { return _header->n_cols; }
+	inline sample_type_t get_sample_type() const { return sample_type_t( _header->sample_type ); }
+	inline double get_scale() const { return _header->scale; }
+	inline double get_offset() const { return _header->offset; }
+	inline double get_source_z_scale() const { return _header->source_z_scale; }
+	/// Samples as stored in the file (float or int16_t):
+	inline const void* get_samples() const { return _samples; }
+
+	inline double get_height( int row, int col ) const
+	{
+		if ( _header->sample_type == FLOAT_SAMPLES )
+			return ( ( const float* ) _samples )[row*_header->n_cols + col];
+		else
+			return _header->offset + _header->scale*( ( const int16_t* ) _samples )[row*_header->n_cols + col];
+	}
+
+	protected:
+
+	Heightmap( const std::string& path );
+
+	const heightmap_header_t* _header;
+	const void* _samples;
+	void* _mapping;
+	size_t _mapping_size;
+};
+
+
+}
+
+
+#endif
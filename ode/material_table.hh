@@ -0,0 +1,121 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MATERIAL_TABLE_HH
+#define MATERIAL_TABLE_HH
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <boost/shared_ptr.hpp>
+
+
+namespace ode
+{
+
+
+// Parameters of the contacts between two materials. The contacts are soft when soft is true or when one
+// of the geoms is SOFT (see collision_feature). slip and bounce are disabled when null.
+typedef struct surface_t
+{
+	double mu;
+	double slip;
+	double bounce;
+	double bounce_vel;
+	bool soft;
+	double soft_erp;
+	double soft_cfm;
+	surface_t( double mu = 0.7 ) : mu( mu ), slip( 0 ), bounce( 0 ), bounce_vel( 0 ), soft( false ), soft_erp( 0.4 ), soft_cfm( 0.005 ) {}
+} surface_t;
+
+
+/// Symmetric table of the surface parameters of every pair of materials. The material 0 ("default") is the
+/// one of the geoms without any material. The IDs of the materials are their indices in the table, so that
+/// a table meant to replace another one in an environment must define the same materials in the same order,
+/// which is the case of a copy of it.
+class Material_table
+{
+	public:
+
+	typedef boost::shared_ptr<Material_table> ptr_t;
+
+	Material_table( const surface_t& default_surface = surface_t() ) : _default( default_surface )
+	{
+		_names.push_back( "default" );
+		_table.push_back( _default );
+	}
+
+	/// Integer ID of a material, registered at the first call with the default surface with every material.
+	int get_material_id( const char* name )
+	{
+		for ( int id = 0 ; id < _names.size() ; id++ )
+			if ( _names[id] == name )
+				return id;
+
+		int n = _names.size();
+		std::vector<surface_t> table( ( n + 1 )*( n + 1 ), _default );
+		for ( int i = 0 ; i < n ; i++ )
+			for ( int j = 0 ; j < n ; j++ )
+				table[i*( n + 1 ) + j] = _table[i*n + j];
+		_table.swap( table );
+		_names.push_back( name );
+
+		return n;
+	}
+
+	const char* get_material_name( int id ) const { return _names[id < size() ? id : 0].c_str(); }
+
+	inline int size() const { return _names.size(); }
+
+	void set_surface( int material_1, int material_2, const surface_t& surface )
+	{
+		if ( material_1 < 0 || material_1 >= size() || material_2 < 0 || material_2 >= size() )
+			throw std::runtime_error( "Unknown material in the material table" );
+		_table[material_1*size() + material_2] = surface;
+		_table[material_2*size() + material_1] = surface;
+	}
+
+	void set_surface( const char* material_1, const char* material_2, const surface_t& surface )
+	{
+		int id_1 = get_material_id( material_1 );
+		int id_2 = get_material_id( material_2 );
+		set_surface( id_1, id_2, surface );
+	}
+
+	/// Materials unknown to this table are treated as the default material.
+	inline const surface_t& get_surface( int material_1, int material_2 ) const
+	{
+		int n = size();
+		if ( material_1 >= n )
+			material_1 = 0;
+		if ( material_2 >= n )
+			material_2 = 0;
+		return _table[material_1*n + material_2];
+	}
+
+	protected:
+
+	surface_t _default;
+	std::vector<std::string> _names;
+	// Surfaces indexed by material_1*size() + material_2:
+	std::vector<surface_t> _table;
+};
+
+
+}
+
+
+#endif
@@ -17,6 +17,7 @@
 */
 
 #include "object.hh"
+#include <stdexcept>
 
 
 namespace ode
@@ -32,7 +33,8 @@ Object::Object( Environment & env, const Eigen::Vector3d& pos ) :
 				_fix( 0x0 ),
 				_casts_shadow( true ),
 				_RGB( NULL ), _alpha( 1 ),
-				_mesh_path( nullptr )
+				_mesh_path( nullptr ),
+				_static( false )
 {
 }
 
@@ -40,7 +42,10 @@ Object::Object( Environment & env, const Eigen::Vector3d& pos ) :
 Object::~Object()
 {
 	if ( _body )
+	{
+		_env._remove_object( this );
 		dBodyDestroy( _body );
+	}
 	if ( ! _geoms.empty() )
 	{
 		for ( dGeomID g : _geoms )
@@ -60,17 +65,39 @@ std::vector<dGeomID> Object::get_geoms() const { return _geoms; }
 
 Eigen::Vector3d Object::get_pos() const
 {
+	if ( _static )
+		return _static_pos;
 	const dReal* pos = dBodyGetPosition( get_body() );
 	return Eigen::Vector3d( pos[0], pos[1], pos[2] );
 }
 
+Eigen::Quaterniond Object::get_quaternion() const
+{
+	if ( _static )
+		return _static_quat;
+	const dReal* q = dBodyGetQuaternion( get_body() );
+	return Eigen::Quaterniond( q[0], q[1], q[2], q[3] );
+}
+
 Eigen::Vector3d Object::get_rot() const
 {
 	//x-y-z convention
 	// http://en.wikipedia.org/wiki/Conversion_between_quaternions_and_Euler_angles
 	// see also : http://www.euclideanspace.com/maths/geometry/rotations/conversions/quaternionToEuler
 	// ode : [ w, x, y, z ], where w is the real part and (x, y, z) form the vector part.
-	const dReal* q = dBodyGetQuaternion( get_body() );
+	// _static_quat is only set for the static objects:
+	dQuaternion static_quat;
+	const dReal* q;
+	if ( _static )
+	{
+		static_quat[0] = _static_quat.w();
+		static_quat[1] = _static_quat.x();
+		static_quat[2] = _static_quat.y();
+		static_quat[3] = _static_quat.z();
+		q = static_quat;
+	}
+	else
+		q = dBodyGetQuaternion( get_body() );
 	double
 	phi = 0, // bank
 	theta = 0, // attitude
@@ -102,12 +129,16 @@ Eigen::Vector3d Object::get_rot() const
 
 Eigen::Vector3d Object::get_vel() const
 {
+	if ( _static )
+		return Eigen::Vector3d::Zero();
 	const dReal* vel = dBodyGetLinearVel( get_body() );
 	return ode_to_vectord( vel );
 }
 
 Eigen::Vector3d Object::get_angvel() const
 {
+	if ( _static )
+		return Eigen::Vector3d::Zero();
 	const dReal* angvel = dBodyGetAngularVel( get_body() );
 	return ode_to_vectord( angvel );
 }
@@ -117,21 +148,45 @@ void Object::set_rotation( double phi, double theta, double psi )
 {
 	dMatrix3 r;
 	dRFromEulerAngles( r, phi, theta, psi );
-	dBodySetRotation( get_body(), r );
+	if ( _static )
+	{
+		dQuaternion q;
+		dQfromR( q, r );
+		_static_quat = Eigen::Quaterniond( q[0], q[1], q[2], q[3] );
+		_update_static_geoms();
+	}
+	else
+		dBodySetRotation( get_body(), r );
 }
 
 void Object::set_rotation( double ax, double ay, double az, double angle )
 {
 	dMatrix3 r;
 	dRFromAxisAndAngle( r, ax, ay, az, angle );
-	dBodySetRotation( get_body(), r );
+	if ( _static )
+	{
+		dQuaternion q;
+		dQfromR( q, r );
+		_static_quat = Eigen::Quaterniond( q[0], q[1], q[2], q[3] );
+		_update_static_geoms();
+	}
+	else
+		dBodySetRotation( get_body(), r );
 }
 
 void Object::set_rotation( const Eigen::Vector3d& a1, const Eigen::Vector3d& a2 )
 {
 	dMatrix3 r;
 	dRFrom2Axes ( r, a1.x(), a1.y(), a1.z(), a2.x(), a2.y(), a2.z() );
-	dBodySetRotation( get_body(), r );
+	if ( _static )
+	{
+		dQuaternion q;
+		dQfromR( q, r );
+		_static_quat = Eigen::Quaterniond( q[0], q[1], q[2], q[3] );
+		_update_static_geoms();
+	}
+	else
+		dBodySetRotation( get_body(), r );
 }
 
 
@@ -146,6 +201,8 @@ const Servo& Object::get_servo2( void ) const { assert( _servo2 ); return *_serv
 
 Eigen::Vector3d Object::get_vground( const Eigen::Vector3d& v ) const
 {
+	if ( _static )
+		return Eigen::Vector3d::Zero();
 	dReal res[3];
 	dBodyGetPointVel( get_body(), v.x(), v.y(), v.z(), res );
 	return ode_to_vectord( res );
@@ -154,7 +211,8 @@ Eigen::Vector3d Object::get_vground( const Eigen::Vector3d& v ) const
 
 void Object::fix()
 {
-	if ( _fix )
+	// A static object has no body to attach:
+	if ( _fix || _static )
 		return;
 	fix_along_axis( Eigen::Vector3d( 0, 0, 1 ) );
 	dJointSetSliderParam( _fix, dParamLoStop, 0 );
@@ -171,7 +229,7 @@ void Object::unfix()
 
 void Object::fix_along_axis( const Eigen::Vector3d& axis )
 {
-	if ( _fix )
+	if ( _fix || _static )
 		return;
 	_fix = dJointCreateSlider( _env.get_world(), 0 );
 	dJointAttach( _fix, _body, 0 );
@@ -181,6 +239,78 @@ void Object::fix_along_axis( const Eigen::Vector3d& axis )
 bool Object::get_fix() const { return _fix == 0; }
 
 
+void Object::make_static()
+{
+	if ( _static || ! _body )
+		return;
+
+	const dReal* pos = dBodyGetPosition( _body );
+	const dReal* q = dBodyGetQuaternion( _body );
+	_static_pos = Eigen::Vector3d( pos[0], pos[1], pos[2] );
+	_static_quat = Eigen::Quaterniond( q[0], q[1], q[2], q[3] );
+
+	_static_geom_pos.resize( _geoms.size() );
+	_static_geom_quat.resize( _geoms.size() );
+	for ( int i = 0 ; i < _geoms.size() ; i++ )
+	{
+		const dReal* geom_pos = dGeomGetPosition( _geoms[i] );
+		dQuaternion geom_q;
+		dGeomGetQuaternion( _geoms[i], geom_q );
+		_static_geom_pos[i] = _static_quat.conjugate()*( Eigen::Vector3d( geom_pos[0], geom_pos[1], geom_pos[2] ) - _static_pos );
+		_static_geom_quat[i] = _static_quat.conjugate()*Eigen::Quaterniond( geom_q[0], geom_q[1], geom_q[2], geom_q[3] );
+		dGeomSetBody( _geoms[i], 0 );
+	}
+
+	unfix();
+	_env._remove_object( this );
+	dBodyDestroy( _body );
+	_body = 0x0;
+	_static = true;
+
+	_update_static_geoms();
+}
+
+
+void Object::set_static_pose( const Eigen::Vector3d& pos, const Eigen::Quaterniond& q )
+{
+	if ( ! _static )
+		throw std::runtime_error( "Only a static object can be moved by set_static_pose" );
+
+	_static_pos = pos;
+	_static_quat = q.normalized();
+	_update_static_geoms();
+}
+
+
+void Object::set_geoms_enabled( bool enabled )
+{
+	for ( dGeomID g : _geoms )
+		if ( enabled )
+			dGeomEnable( g );
+		else
+			dGeomDisable( g );
+}
+
+
+bool Object::are_geoms_enabled() const
+{
+	return ! _geoms.empty() && dGeomIsEnabled( _geoms[0] );
+}
+
+
+void Object::_update_static_geoms()
+{
+	for ( int i = 0 ; i < _geoms.size() ; i++ )
+	{
+		Eigen::Vector3d pos = _static_pos + _static_quat*_static_geom_pos[i];
+		Eigen::Quaterniond q = _static_quat*_static_geom_quat[i];
+		dQuaternion geom_q = { q.w(), q.x(), q.y(), q.z() };
+		dGeomSetPosition( _geoms[i], pos.x(), pos.y(), pos.z() );
+		dGeomSetQuaternion( _geoms[i], geom_q );
+	}
+}
+
+
 const Environment& Object::get_env() const { return _env; }
 
 
@@ -226,7 +356,7 @@ const char* Object::get_collision_group( int index ) const
 	{
 		collision_feature* feature = ( collision_feature* ) dGeomGetData( _geoms[index] );
 		if ( feature != NULL )
-			return feature->group;
+			return _env.get_collision_group_name( feature->group );
 	}
 	return NULL;
 }
@@ -235,13 +365,15 @@ void Object::set_all_collision_group( const char* group )
 {
 	if ( ! _geoms.empty() )
 	{
+		int group_id = _env.get_collision_group_id( group );
 		for ( dGeomID g : _geoms )
 		{
 			collision_feature* feature = ( collision_feature* ) dGeomGetData( g );
 			if ( feature != NULL )
-				feature->group = group;
+				feature->group = group_id;
 			else
-				dGeomSetData( g, new collision_feature( group ) );
+				dGeomSetData( g, new collision_feature( group_id ) );
+			_env.set_collision_bits( g );
 		}
 	}
 }
@@ -250,11 +382,14 @@ void Object::set_collision_group( const char* group, int index )
 {
 	if ( ! _geoms.empty() )
 	{
-		collision_feature* feature = ( collision_feature* ) dGeomGetData( index < 0 ? _geoms.back() : _geoms[index] );
+		int group_id = _env.get_collision_group_id( group );
+		dGeomID g = ( index < 0 ? _geoms.back() : _geoms[index] );
+		collision_feature* feature = ( collision_feature* ) dGeomGetData( g );
 		if ( feature != NULL )
-			feature->group = group;
+			feature->group = group_id;
 		else
-			dGeomSetData( ( index < 0 ? _geoms.back() : _geoms[index] ), new collision_feature( group ) );
+			dGeomSetData( g, new collision_feature( group_id ) );
+		_env.set_collision_bits( g );
 	}
 }
 
@@ -276,11 +411,13 @@ void Object::set_contact_type( contact_type type, int index )
 {
 	if ( ! _geoms.empty() )
 	{
-		collision_feature* feature = ( collision_feature* ) dGeomGetData( index < 0 ? _geoms.back() : _geoms[index] );
+		dGeomID g = ( index < 0 ? _geoms.back() : _geoms[index] );
+		collision_feature* feature = ( collision_feature* ) dGeomGetData( g );
 		if ( feature != NULL )
 			feature->type = type;
 		else
-			dGeomSetData( ( index < 0 ? _geoms.back() : _geoms[index] ), new collision_feature( type ) );
+			dGeomSetData( g, new collision_feature( type ) );
+		_env.set_collision_bits( g );
 	}
 }
 
@@ -295,19 +432,81 @@ void Object::set_all_contact_type( contact_type type )
 				feature->type = type;
 			else
 				dGeomSetData( g, new collision_feature( type ) );
+			_env.set_collision_bits( g );
 		}
 	}
 }
 
+void Object::set_contact_stiffness( double kp, double kd, int index )
+{
+	if ( ! _geoms.empty() )
+	{
+		dGeomID g = ( index < 0 ? _geoms.back() : _geoms[index] );
+		collision_feature* feature = ( collision_feature* ) dGeomGetData( g );
+		if ( feature == NULL )
+		{
+			feature = new collision_feature( HARD );
+			dGeomSetData( g, feature );
+		}
+		feature->kp = kp;
+		feature->kd = kd;
+	}
+}
+
+const char* Object::get_material( int index ) const
+{
+	if ( _geoms.size() > index )
+	{
+		collision_feature* feature = ( collision_feature* ) dGeomGetData( _geoms[index] );
+		return _env.get_material_table()->get_material_name( feature != NULL ? feature->material : 0 );
+	}
+	return NULL;
+}
+
+void Object::set_all_material( const char* material )
+{
+	if ( ! _geoms.empty() )
+	{
+		int material_id = _env.get_material_id( material );
+		for ( dGeomID g : _geoms )
+		{
+			collision_feature* feature = ( collision_feature* ) dGeomGetData( g );
+			if ( feature == NULL )
+			{
+				feature = new collision_feature( HARD );
+				dGeomSetData( g, feature );
+			}
+			feature->material = material_id;
+		}
+	}
+}
+
+void Object::set_material( const char* material, int index )
+{
+	if ( ! _geoms.empty() )
+	{
+		dGeomID g = ( index < 0 ? _geoms.back() : _geoms[index] );
+		collision_feature* feature = ( collision_feature* ) dGeomGetData( g );
+		if ( feature == NULL )
+		{
+			feature = new collision_feature( HARD );
+			dGeomSetData( g, feature );
+		}
+		feature->material = _env.get_material_id( material );
+	}
+}
+
 void Object::set_collision_callback( std::function<void(collision_feature*)> callback, int index )
 {
 	if ( ! _geoms.empty() )
 	{
-		collision_feature* feature = ( collision_feature* ) dGeomGetData( index < 0 ? _geoms.back() : _geoms[index] );
+		dGeomID g = ( index < 0 ? _geoms.back() : _geoms[index] );
+		collision_feature* feature = ( collision_feature* ) dGeomGetData( g );
 		if ( feature != NULL )
 			feature->callback = callback;
 		else
-			dGeomSetData( ( index < 0 ? _geoms.back() : _geoms[index] ), new collision_feature( callback ) );
+			dGeomSetData( g, new collision_feature( callback ) );
+		_env.set_collision_bits( g );
 	}
 }
 
@@ -322,6 +521,7 @@ void Object::set_all_collision_callback( std::function<void(collision_feature*)>
 				feature->callback = callback;
 			else
 				dGeomSetData( g, new collision_feature( callback ) );
+			_env.set_collision_bits( g );
 		}
 	}
 }
@@ -357,6 +557,7 @@ void Object::init()
 					  _init_pos.y(),
 					  _init_pos.z() );
 	dBodySetData( _body, this );
+	_env._add_object( this );
 }
 
 
@@ -379,6 +580,7 @@ void Object::_copy( const Object& o )
 	_init_pos = o.get_pos();
 
 	dBodySetData( _body, this );
+	_env._add_object( this );
 }
 
 
@@ -423,6 +625,7 @@ Object* Object::add_box_geom( double l, double w, double h )
 {
 	dGeomID g = dCreateBox( _env.get_space(), l , w, h );
 	dGeomSetBody( g, _body );
+	_env.set_collision_bits( g );
 	_geoms.push_back( g );
 	return this;
 }
@@ -431,6 +634,7 @@ Object* Object::add_sphere_geom( double r )
 {
 	dGeomID g = dCreateSphere( _env.get_space(), r );
 	dGeomSetBody( g, _body );
+	_env.set_collision_bits( g );
 	_geoms.push_back( g );
 	return this;
 }
@@ -439,6 +643,7 @@ Object* Object::add_cylinder_geom( double r, double l )
 {
 	dGeomID g = dCreateCylinder( _env.get_space(), r, l );
 	dGeomSetBody( g, _body );
+	_env.set_collision_bits( g );
 	_geoms.push_back( g );
 	return this;
 }
@@ -447,7 +652,18 @@ Object* Object::add_capcyl_geom( double r, double l )
 {
 	dGeomID g = dCreateCCylinder( _env.get_space(), r, l );
 	dGeomSetBody( g, _body );
+	_env.set_collision_bits( g );
+	_geoms.push_back( g );
+	return this;
+}
+
+Object* Object::add_trimesh_geom( Trimesh_data::ptr_t mesh )
+{
+	dGeomID g = dCreateTriMesh( _env.get_space(), mesh->get_id(), NULL, NULL, NULL );
+	dGeomSetBody( g, _body );
+	_env.set_collision_bits( g );
 	_geoms.push_back( g );
+	_trimeshes.push_back( mesh );
 	return this;
 }
 
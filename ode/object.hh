@@ -27,6 +27,7 @@
 
 #include "environment.hh"
 #include "visitor.hh"
+#include "trimesh.hh"
 
 #include <time.h>
 #include <sys/time.h>
@@ -59,6 +60,7 @@ class Object
 	Eigen::Vector3d get_rot() const;
 	Eigen::Vector3d get_vel() const;
 	Eigen::Vector3d get_angvel() const;
+	Eigen::Quaterniond get_quaternion() const;
 
 	/// set an absolute rotation ( euler angles )
 	void set_rotation( double phi, double theta, double psi );
@@ -91,6 +93,18 @@ class Object
 	/// true if fixed
 	bool get_fix() const;
 
+	/// Turn the object into static geometry: its body (and fixing joint) is destroyed and its geoms
+	/// stay at their current pose in the world. Static geoms add no work to the step solver.
+	/// A static object has a null velocity and is already fixed (fix and fix_along_axis do nothing).
+	void make_static();
+	inline bool is_static() const { return _static; }
+	/// Move a static object, without any effect on the bodies of the world:
+	void set_static_pose( const Eigen::Vector3d& pos, const Eigen::Quaterniond& q );
+
+	/// Disabled geoms are ignored by the collision detection:
+	void set_geoms_enabled( bool enabled );
+	bool are_geoms_enabled() const;
+
 	const Environment& get_env() const;
 
 	double get_mass() const;
@@ -110,6 +124,13 @@ class Object
 	void set_all_contact_type( contact_type type );
 	void set_contact_type( contact_type type, int index = -1 );
 
+	/// Spring-damper of the soft contacts of a geom (see collision_feature):
+	void set_contact_stiffness( double kp, double kd, int index = -1 );
+	/// Material of the geoms, registered in the material table of the environment at the first use:
+	const char* get_material( int index = 0 ) const;
+	void set_all_material( const char* material );
+	void set_material( const char* material, int index = -1 );
+
 	void set_all_collision_callback( std::function<void(collision_feature*)> callback );
 	void set_collision_callback( std::function<void(collision_feature*)> callback, int index = -1 );
 
@@ -129,6 +150,8 @@ class Object
 	Object* add_sphere_geom( double r );
 	Object* add_cylinder_geom( double r, double l );
 	Object* add_capcyl_geom( double r, double l );
+	/// The mesh data is kept alive by the object:
+	Object* add_trimesh_geom( Trimesh_data::ptr_t mesh );
 
 	Object* set_geom_abs_pos( const Eigen::Vector3d& pos, int index = -1 );
 	Object* set_geom_rel_pos( const Eigen::Vector3d& pos, int index = -1 );
@@ -143,6 +166,8 @@ class Object
 	// does not copy servos ( they must be copied later )
 	void _copy( const Object& o );
 
+	void _update_static_geoms();
+
 	dMass _m;
 	dBodyID _body;
 	std::vector<dGeomID> _geoms;
@@ -154,6 +179,13 @@ class Object
 	bool _casts_shadow;
 	float *_RGB, _alpha;
 	const char* _mesh_path;
+	std::vector<Trimesh_data::ptr_t> _trimeshes;
+	// Pose of a static object and of its geoms relatively to it:
+	bool _static;
+	Eigen::Vector3d _static_pos;
+	Eigen::Quaterniond _static_quat;
+	std::vector<Eigen::Vector3d> _static_geom_pos;
+	std::vector<Eigen::Quaterniond> _static_geom_quat;
 };
 
 
@@ -20,7 +20,15 @@ class Robot
 
 	typedef boost::shared_ptr<Robot> ptr_t;
 
-	Robot() {}
+	// Internal state of the robot, complementary to the state of its bodies saved by ode::Environment:
+	typedef struct state_t
+	{
+		std::vector<ode::Servo::state_t> servos;
+		virtual ~state_t() {}
+	} state_t;
+	typedef boost::shared_ptr<state_t> state_ptr_t;
+
+	Robot() : _space( 0 ) {}
 
 	inline const std::vector<ode::Object::ptr_t>& bodies() const { return _bodies; }
 	inline std::vector<ode::Object::ptr_t>& bodies() { return _bodies; }
@@ -44,6 +52,26 @@ class Robot
 			o->set_collision_group( group );
 	}
 
+	/// Move all the geoms of the robot into a nested space of the environment, so that the pairs of
+	/// geoms of the robot are not tested against each other. Geoms added afterwards are not moved.
+	void set_own_space( ode::Environment& env )
+	{
+		if ( _space )
+			return;
+		_space = dSimpleSpaceCreate( env.get_space() );
+		// The geoms are destroyed by their objects:
+		dSpaceSetCleanup( _space, 0 );
+		BOOST_FOREACH( ode::Object::ptr_t o, _bodies ) 
+			for ( dGeomID g : o->get_geoms() )
+			{
+				if ( dGeomGetSpace( g ) )
+					dSpaceRemove( dGeomGetSpace( g ), g );
+				dSpaceAdd( _space, g );
+			}
+	}
+
+	inline dSpaceID get_space() const { return _space; }
+
 	void set_color( float r, float g, float b )
 	{
 		BOOST_FOREACH( ode::Object::ptr_t o, _bodies ) 
@@ -64,11 +92,39 @@ class Robot
 			s->next_step( dt );
 	}
 
+	virtual state_ptr_t save_state() const
+	{
+		state_ptr_t state( new state_t );
+		_save_state( *state );
+		return state;
+	}
+
+	/// The state must have been saved by the same robot.
+	virtual void restore_state( const state_t& state )
+	{
+		for ( int i = 0 ; i < _servos.size() ; i++ )
+			_servos[i]->restore_state( state.servos[i] );
+	}
+
+	virtual ~Robot()
+	{
+		if ( _space )
+			dSpaceDestroy( _space );
+	}
+
 	protected:
 
+	void _save_state( state_t& state ) const
+	{
+		state.servos.resize( _servos.size() );
+		for ( int i = 0 ; i < _servos.size() ; i++ )
+			_servos[i]->save_state( state.servos[i] );
+	}
+
 	std::vector<ode::Object::ptr_t> _bodies;
 	std::vector<ode::Servo::ptr_t> _servos;
 	ode::Object::ptr_t _main_body;
+	dSpaceID _space;
 };
 
 
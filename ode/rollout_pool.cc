@@ -0,0 +1,119 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ode/rollout_pool.hh"
+#include "ode/environment.hh"
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace ode
+{
+
+
+Rollout_pool::Rollout_pool( unsigned int n_threads ) :
+                            _n_jobs( 0 ), _next_job( 0 ), _n_done( 0 ), _stop( false )
+{
+	dInitODE2( 0 );
+
+	if ( n_threads == 0 )
+		n_threads = std::max( 1u, std::thread::hardware_concurrency() );
+
+	for ( unsigned int i = 0 ; i < n_threads ; i++ )
+		_threads.push_back( std::thread( &Rollout_pool::_worker, this, i ) );
+}
+
+
+void Rollout_pool::run( unsigned int n_jobs, std::function<void(unsigned int,unsigned int)> job )
+{
+	if ( n_jobs == 0 )
+		return;
+
+	std::unique_lock<std::mutex> lock( _mutex );
+
+	_job = job;
+	_n_jobs = n_jobs;
+	_next_job = 0;
+	_n_done = 0;
+	_exception = nullptr;
+	_cv_start.notify_all();
+
+	_cv_done.wait( lock, [this]() { return _n_done == _n_jobs; } );
+
+	_job = nullptr;
+
+	if ( _exception )
+		std::rethrow_exception( _exception );
+}
+
+
+void Rollout_pool::_worker( unsigned int worker_index )
+{
+	// Each thread needs its own ODE data to run collision detection:
+	bool ode_data_allocated = dAllocateODEDataForThread( dAllocateMaskAll );
+
+	std::unique_lock<std::mutex> lock( _mutex );
+
+	while ( true )
+	{
+		_cv_start.wait( lock, [this]() { return _stop || _next_job < _n_jobs; } );
+		if ( _stop )
+			break;
+
+		unsigned int job_index = _next_job++;
+
+		lock.unlock();
+		try
+		{
+			if ( ! ode_data_allocated )
+				throw std::runtime_error( "Failed to allocate the ODE data of a rollout worker" );
+			_job( job_index, worker_index );
+		}
+		catch ( ... )
+		{
+			lock.lock();
+			if ( ! _exception )
+				_exception = std::current_exception();
+			lock.unlock();
+		}
+		lock.lock();
+
+		if ( ++_n_done == _n_jobs )
+			_cv_done.notify_all();
+	}
+
+	lock.unlock();
+	if ( ode_data_allocated )
+		dCleanupODEAllDataForThread();
+}
+
+
+Rollout_pool::~Rollout_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_stop = true;
+	}
+	_cv_start.notify_all();
+
+	for ( std::thread& thread : _threads )
+		thread.join();
+
+	dCloseODE();
+}
+
+
+}
@@ -0,0 +1,74 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ROLLOUT_POOL_HH
+#define ROLLOUT_POOL_HH
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <boost/shared_ptr.hpp>
+
+
+namespace ode
+{
+
+
+/// Pool of persistent worker threads on which independent simulations are run in parallel.
+/// Each worker allocates its own ODE thread data once, so that every worker can build and
+/// step its own worlds. ODE must have been built with thread support (--enable-ou).
+class Rollout_pool
+{
+	public:
+
+	typedef boost::shared_ptr<Rollout_pool> ptr_t;
+
+	/// n_threads = 0 uses one worker per hardware thread.
+	Rollout_pool( unsigned int n_threads = 0 );
+
+	inline unsigned int size() const { return _threads.size(); }
+
+	/// Call job( job_index, worker_index ) for every job_index in [0, n_jobs) and wait for all of them
+	/// to complete. The first exception thrown by a job is rethrown once the batch is over.
+	void run( unsigned int n_jobs, std::function<void(unsigned int,unsigned int)> job );
+
+	~Rollout_pool();
+
+	protected:
+
+	void _worker( unsigned int worker_index );
+
+	std::vector<std::thread> _threads;
+	std::mutex _mutex;
+	std::condition_variable _cv_start;
+	std::condition_variable _cv_done;
+
+	std::function<void(unsigned int,unsigned int)> _job;
+	unsigned int _n_jobs;
+	unsigned int _next_job;
+	unsigned int _n_done;
+	bool _stop;
+	std::exception_ptr _exception;
+};
+
+
+}
+
+
+#endif
@@ -179,6 +179,28 @@ double Servo::get_true_vel() const
 }
 
 
+void Servo::save_state( state_t& state ) const
+{
+	state.passive = _passive;
+	state.angle = _angle;
+	state.vel = _vel;
+	state.mode = _mode;
+	state.joint_vel = dJointGetHingeParam( _joint, dParamVel );
+	state.joint_fmax = dJointGetHingeParam( _joint, dParamFMax );
+}
+
+
+void Servo::restore_state( const state_t& state )
+{
+	_passive = state.passive;
+	_angle = state.angle;
+	_vel = state.vel;
+	_mode = state.mode;
+	dJointSetHingeParam( _joint, dParamVel, state.joint_vel );
+	dJointSetHingeParam( _joint, dParamFMax, state.joint_fmax );
+}
+
+
 Servo::~Servo()
 {
 	dJointDestroy( _joint );
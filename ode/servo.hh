@@ -18,6 +18,16 @@ class Servo
 
 	typedef enum { POS, VEL } servo_mode_t;
 
+	typedef struct state_t
+	{
+		bool passive;
+		double angle;
+		double vel;
+		servo_mode_t mode;
+		dReal joint_vel;
+		dReal joint_fmax;
+	} state_t;
+
 	Servo( Environment& env,
 		   Object& o1, Object& o2,
 		   const Eigen::Vector3d& anchor,
@@ -66,6 +76,9 @@ class Servo
 	double get_true_angle() const;
 	double get_true_vel() const;
 
+	void save_state( state_t& state ) const;
+	void restore_state( const state_t& state );
+
 	~Servo();
 
 	protected:
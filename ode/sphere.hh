@@ -41,10 +41,18 @@ class Sphere : public Object
 
 	double get_radius() const { return _radius; }
 
+	/// Resize the geom, but not the mass of the body (meant for static spheres):
+	void set_radius( double radius )
+	{
+		_radius = radius;
+		if ( ! _geoms.empty() )
+			dGeomSphereSetRadius( _geoms[0], radius );
+	}
+
 	/// const visitor
 	virtual void accept( ConstVisitor &v ) const
 	{
-		assert( _body );
+		assert( _body || _static );
 		v.visit( *this );
 	}
 
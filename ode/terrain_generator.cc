@@ -0,0 +1,270 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ode/terrain_generator.hh"
+#include <stdexcept>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <stdint.h>
+
+
+namespace ode
+{
+
+
+Terrain_spec::Terrain_spec( double length, double width, double resolution ) : _length( length ), _width( width )
+{
+	if ( length <= 0 || width <= 0 || resolution <= 0 )
+		throw std::runtime_error( "Invalid dimensions of terrain" );
+
+	_n_cols = std::max( 2, int( lround( length/resolution ) ) + 1 );
+	_n_rows = std::max( 2, int( lround( width/resolution ) ) + 1 );
+}
+
+
+Terrain_spec& Terrain_spec::_add( terrain_feature_type_t type, double p0, double p1, double p2, double p3, double p4 )
+{
+	_features.push_back( { type, { p0, p1, p2, p3, p4 } } );
+	return *this;
+}
+
+
+Terrain_spec& Terrain_spec::add_step( double x, double height, double angle )
+{
+	return _add( STEP_FEATURE, x, height, angle );
+}
+
+
+Terrain_spec& Terrain_spec::add_groove( double x, double groove_width, double depth, double angle )
+{
+	return _add( GROOVE_FEATURE, x, groove_width, depth, angle );
+}
+
+
+Terrain_spec& Terrain_spec::add_ramp( double x, double ramp_length, double height, double angle )
+{
+	return _add( RAMP_FEATURE, x, ramp_length, height, angle );
+}
+
+
+Terrain_spec& Terrain_spec::add_rocks( int n, double min_radius, double max_radius, double height_ratio )
+{
+	return _add( ROCKS_FEATURE, n, min_radius, max_radius, height_ratio );
+}
+
+
+Terrain_spec& Terrain_spec::add_fractal_noise( double amplitude, double wavelength, int octaves, double persistence )
+{
+	return _add( FRACTAL_FEATURE, amplitude, wavelength, octaves, persistence );
+}
+
+
+std::string Terrain_spec::key() const
+{
+	std::string key;
+	key.append( ( const char* ) &_length, sizeof( _length ) );
+	key.append( ( const char* ) &_width, sizeof( _width ) );
+	key.append( ( const char* ) &_n_rows, sizeof( _n_rows ) );
+	key.append( ( const char* ) &_n_cols, sizeof( _n_cols ) );
+	for ( const terrain_feature_t& feature : _features )
+	{
+		key.append( ( const char* ) &feature.type, sizeof( feature.type ) );
+		key.append( ( const char* ) feature.params, sizeof( feature.params ) );
+	}
+	return key;
+}
+
+
+// Random value in [-1, 1] attached to a node of the noise lattice:
+static double _lattice_value( int64_t ix, int64_t iy, uint32_t seed )
+{
+	uint64_t h = uint64_t( ix )*0x9E3779B97F4A7C15ull ^ uint64_t( iy )*0xC2B2AE3D27D4EB4Full ^ uint64_t( seed )*0x165667B19E3779F9ull;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return ( h >> 11 )*( 2./9007199254740992. ) - 1;
+}
+
+
+static double _value_noise( double x, double y, uint32_t seed )
+{
+	double fx = floor( x );
+	double fy = floor( y );
+	int64_t ix = int64_t( fx );
+	int64_t iy = int64_t( fy );
+	double tx = x - fx;
+	double ty = y - fy;
+	tx = tx*tx*( 3 - 2*tx );
+	ty = ty*ty*( 3 - 2*ty );
+
+	double v00 = _lattice_value( ix, iy, seed );
+	double v10 = _lattice_value( ix + 1, iy, seed );
+	double v01 = _lattice_value( ix, iy + 1, seed );
+	double v11 = _lattice_value( ix + 1, iy + 1, seed );
+
+	return ( v00*( 1 - tx ) + v10*tx )*( 1 - ty ) + ( v01*( 1 - tx ) + v11*tx )*ty;
+}
+
+
+Terrain_map::ptr_t Terrain_generator::build( const Terrain_spec& spec, unsigned int seed )
+{
+	Terrain_map::ptr_t map( new Terrain_map( spec.get_rows(), spec.get_cols(), spec.get_length(), spec.get_width() ) );
+	int n_rows = map->get_rows();
+	int n_cols = map->get_cols();
+
+	for ( int f = 0 ; f < spec.get_features().size() ; f++ )
+	{
+		const terrain_feature_t& feature = spec.get_features()[f];
+		const double* p = feature.params;
+		// Each feature gets its own random sequence, so that adding a feature doesn't change the others:
+		uint32_t feature_seed = seed ^ ( uint32_t( f + 1 )*0x9E3779B9u );
+
+		switch ( feature.type )
+		{
+			case STEP_FEATURE :
+			case GROOVE_FEATURE :
+			case RAMP_FEATURE :
+			{
+				double angle = ( feature.type == STEP_FEATURE ? p[2] : p[3] );
+				double cos_a = cos( angle );
+				double sin_a = sin( angle );
+				for ( int r = 0 ; r < n_rows ; r++ )
+					for ( int c = 0 ; c < n_cols ; c++ )
+					{
+						double u = map->get_x( c )*cos_a + map->get_y( r )*sin_a - p[0];
+						if ( feature.type == STEP_FEATURE )
+						{
+							if ( u >= 0 )
+								map->height( r, c ) += p[1];
+						}
+						else if ( feature.type == GROOVE_FEATURE )
+						{
+							if ( fabs( u ) <= p[1]/2 )
+								map->height( r, c ) -= p[2];
+						}
+						else
+							map->height( r, c ) += p[2]*std::min( std::max( u/p[1], 0. ), 1. );
+					}
+				break;
+			}
+			case ROCKS_FEATURE :
+			{
+				std::mt19937 gen( feature_seed );
+				auto uniform = [&gen]() { return ( gen() + 0.5 )/4294967296.; };
+				double dx = map->get_length()/( n_cols - 1 );
+				double dy = map->get_width()/( n_rows - 1 );
+				for ( int i = 0 ; i < int( p[0] ) ; i++ )
+				{
+					double x = ( uniform() - 0.5 )*map->get_length();
+					double y = ( uniform() - 0.5 )*map->get_width();
+					double radius = p[1] + ( p[2] - p[1] )*uniform();
+					double height = radius*p[3];
+
+					// Only the samples under the rock are visited:
+					int c_min = std::max( 0, int( ceil( ( x - radius + map->get_length()/2 )/dx ) ) );
+					int c_max = std::min( n_cols - 1, int( floor( ( x + radius + map->get_length()/2 )/dx ) ) );
+					int r_min = std::max( 0, int( ceil( ( map->get_width()/2 - y - radius )/dy ) ) );
+					int r_max = std::min( n_rows - 1, int( floor( ( map->get_width()/2 - y + radius )/dy ) ) );
+					for ( int r = r_min ; r <= r_max ; r++ )
+						for ( int c = c_min ; c <= c_max ; c++ )
+						{
+							double ex = map->get_x( c ) - x;
+							double ey = map->get_y( r ) - y;
+							double d2 = ( ex*ex + ey*ey )/( radius*radius );
+							if ( d2 < 1 )
+								map->height( r, c ) += height*sqrt( 1 - d2 );
+						}
+				}
+				break;
+			}
+			case FRACTAL_FEATURE :
+			{
+				for ( int r = 0 ; r < n_rows ; r++ )
+					for ( int c = 0 ; c < n_cols ; c++ )
+					{
+						double amplitude = p[0];
+						double frequency = 1/p[1];
+						double z = 0;
+						for ( int o = 0 ; o < int( p[2] ) ; o++ )
+						{
+							z += amplitude*_value_noise( map->get_x( c )*frequency, map->get_y( r )*frequency, feature_seed + o );
+							amplitude *= p[3];
+							frequency *= 2;
+						}
+						map->height( r, c ) += z;
+					}
+				break;
+			}
+			default :
+				throw std::runtime_error( "Unknown terrain feature" );
+		}
+	}
+
+	return map;
+}
+
+
+Terrain_map::ptr_t Terrain_generator::generate( const Terrain_spec& spec, unsigned int seed )
+{
+	std::string key = spec.key();
+	key.append( ( const char* ) &seed, sizeof( seed ) );
+
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		auto it = _cache_index.find( key );
+		if ( it != _cache_index.end() )
+		{
+			_cache.splice( _cache.begin(), _cache, it->second );
+			_cache_hits++;
+			return it->second->second;
+		}
+		_cache_misses++;
+	}
+
+	// The generation itself is done without holding the lock:
+	Terrain_map::ptr_t map = build( spec, seed );
+
+	std::lock_guard<std::mutex> lock( _mutex );
+	if ( _cache_capacity == 0 || _cache_index.count( key ) > 0 )
+		return map;
+	_cache.push_front( cache_entry_t( key, map ) );
+	_cache_index[key] = _cache.begin();
+	while ( _cache.size() > _cache_capacity )
+	{
+		_cache_index.erase( _cache.back().first );
+		_cache.pop_back();
+	}
+
+	return map;
+}
+
+
+void Terrain_generator::set_cache_capacity( size_t capacity )
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	_cache_capacity = capacity;
+	while ( _cache.size() > _cache_capacity )
+	{
+		_cache_index.erase( _cache.back().first );
+		_cache.pop_back();
+	}
+}
+
+
+}
@@ -0,0 +1,159 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TERRAIN_GENERATOR_HH
+#define TERRAIN_GENERATOR_HH
+
+#include <vector>
+#include <list>
+#include <map>
+#include <string>
+#include <mutex>
+#include <boost/shared_ptr.hpp>
+
+
+namespace ode
+{
+
+
+typedef enum terrain_feature_type_t
+{
+	STEP_FEATURE,
+	GROOVE_FEATURE,
+	RAMP_FEATURE,
+	ROCKS_FEATURE,
+	FRACTAL_FEATURE
+} terrain_feature_type_t;
+
+typedef struct terrain_feature_t
+{
+	terrain_feature_type_t type;
+	double params[5];
+} terrain_feature_t;
+
+
+/// Description of a procedural terrain of length x width metres centred on the origin, sampled every resolution
+/// metres. The features are applied in the order they are added. The steps, grooves and ramps are straight,
+/// across the terrain, and their position x is measured along the direction given by angle (in radians, from
+/// the x axis).
+class Terrain_spec
+{
+	public:
+
+	Terrain_spec( double length, double width, double resolution );
+
+	/// Rise of height beyond x:
+	Terrain_spec& add_step( double x, double height, double angle = 0 );
+	/// Trench of the given width and depth centred on x:
+	Terrain_spec& add_groove( double x, double groove_width, double depth, double angle = 0 );
+	/// Linear slope from x to x + ramp_length, rising of height:
+	Terrain_spec& add_ramp( double x, double ramp_length, double height, double angle = 0 );
+	/// n half-ellipsoids of radius drawn between min_radius and max_radius, and of height radius*height_ratio:
+	Terrain_spec& add_rocks( int n, double min_radius, double max_radius, double height_ratio = 0.5 );
+	/// Fractional Brownian motion of value noise, of the given amplitude at the base wavelength, the amplitude
+	/// being multiplied by persistence at each octave while the wavelength is halved:
+	Terrain_spec& add_fractal_noise( double amplitude, double wavelength, int octaves, double persistence = 0.5 );
+
+	inline int get_rows() const { return _n_rows; }
+	inline int get_cols() const { return _n_cols; }
+	inline double get_length() const { return _length; }
+	inline double get_width() const { return _width; }
+	inline const std::vector<terrain_feature_t>& get_features() const { return _features; }
+
+	/// Exact binary representation of the spec, used as cache key:
+	std::string key() const;
+
+	protected:
+
+	Terrain_spec& _add( terrain_feature_type_t type, double p0, double p1 = 0, double p2 = 0, double p3 = 0, double p4 = 0 );
+
+	double _length;
+	double _width;
+	int _n_rows;
+	int _n_cols;
+	std::vector<terrain_feature_t> _features;
+};
+
+
+/// Heights generated from a Terrain_spec, laid out as expected by the heightmap constructor of ode::HeightField
+/// (the row 0 at the highest y, the column 0 at the lowest x). The map must outlive the HeightField built on it.
+class Terrain_map
+{
+	public:
+
+	typedef boost::shared_ptr<Terrain_map> ptr_t;
+
+	Terrain_map( int n_rows, int n_cols, double length, double width ) :
+	             _heights( n_rows*n_cols, 0. ), _n_rows( n_rows ), _n_cols( n_cols ), _length( length ), _width( width ) {}
+
+	inline double* data() { return _heights.data(); }
+	inline int get_rows() const { return _n_rows; }
+	inline int get_cols() const { return _n_cols; }
+	inline double get_length() const { return _length; }
+	inline double get_width() const { return _width; }
+	inline double get_height( int row, int col ) const { return _heights[row*_n_cols + col]; }
+	inline double& height( int row, int col ) { return _heights[row*_n_cols + col]; }
+
+	/// Position of the samples relative to the centre of the heightfield:
+	inline double get_x( int col ) const { return -_length/2 + col*_length/( _n_cols - 1 ); }
+	inline double get_y( int row ) const { return _width/2 - row*_width/( _n_rows - 1 ); }
+
+	protected:
+
+	std::vector<double> _heights;
+	int _n_rows;
+	int _n_cols;
+	double _length;
+	double _width;
+};
+
+
+/// Generation of the terrains, deterministic for a given spec and seed. The last maps generated are kept in
+/// a least recently used cache, so that the same terrain requested again is returned without being rebuilt.
+/// The maps in the cache are shared and must not be modified. generate() can be called from several threads.
+class Terrain_generator
+{
+	public:
+
+	Terrain_generator( size_t cache_capacity = 16 ) : _cache_capacity( cache_capacity ), _cache_hits( 0 ), _cache_misses( 0 ) {}
+
+	Terrain_map::ptr_t generate( const Terrain_spec& spec, unsigned int seed );
+
+	/// Generate a map without going through the cache:
+	static Terrain_map::ptr_t build( const Terrain_spec& spec, unsigned int seed );
+
+	void set_cache_capacity( size_t capacity );
+	inline size_t get_cache_hits() const { return _cache_hits; }
+	inline size_t get_cache_misses() const { return _cache_misses; }
+
+	protected:
+
+	typedef std::pair<std::string,Terrain_map::ptr_t> cache_entry_t;
+
+	size_t _cache_capacity;
+	// Most recently used first:
+	std::list<cache_entry_t> _cache;
+	std::map<std::string,std::list<cache_entry_t>::iterator> _cache_index;
+	std::mutex _mutex;
+	size_t _cache_hits;
+	size_t _cache_misses;
+};
+
+
+}
+
+
+#endif
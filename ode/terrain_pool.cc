@@ -0,0 +1,114 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ode/terrain_pool.hh"
+
+
+namespace ode
+{
+
+
+void Terrain_pool::begin()
+{
+	_n_boxes = 0;
+	_n_spheres = 0;
+	_n_cylinders = 0;
+}
+
+
+Box& Terrain_pool::add_box( const Eigen::Vector3d& pos, double l, double w, double h, const Eigen::Quaterniond& q )
+{
+	if ( _n_boxes == _boxes.size() )
+	{
+		boost::shared_ptr<Box> box( new Box( _env, pos, 1, l, w, h, false ) );
+		box->make_static();
+		box->set_collision_group( _collision_group.c_str() );
+		_boxes.push_back( box );
+		_n_created++;
+	}
+
+	Box& box = *_boxes[_n_boxes++];
+	box.set_size( l, w, h );
+	box.set_static_pose( pos, q );
+	box.set_geoms_enabled( true );
+
+	return box;
+}
+
+
+Sphere& Terrain_pool::add_sphere( const Eigen::Vector3d& pos, double radius )
+{
+	if ( _n_spheres == _spheres.size() )
+	{
+		boost::shared_ptr<Sphere> sphere( new Sphere( _env, pos, 1, radius, false ) );
+		sphere->make_static();
+		sphere->set_collision_group( _collision_group.c_str() );
+		_spheres.push_back( sphere );
+		_n_created++;
+	}
+
+	Sphere& sphere = *_spheres[_n_spheres++];
+	sphere.set_radius( radius );
+	sphere.set_static_pose( pos, Eigen::Quaterniond::Identity() );
+	sphere.set_geoms_enabled( true );
+
+	return sphere;
+}
+
+
+Cylinder& Terrain_pool::add_cylinder( const Eigen::Vector3d& pos, double radius, double length, const Eigen::Quaterniond& q )
+{
+	if ( _n_cylinders == _cylinders.size() )
+	{
+		boost::shared_ptr<Cylinder> cylinder( new Cylinder( _env, pos, 1, radius, length, false ) );
+		cylinder->make_static();
+		cylinder->set_collision_group( _collision_group.c_str() );
+		_cylinders.push_back( cylinder );
+		_n_created++;
+	}
+
+	Cylinder& cylinder = *_cylinders[_n_cylinders++];
+	cylinder.set_size( radius, length );
+	cylinder.set_static_pose( pos, q );
+	cylinder.set_geoms_enabled( true );
+
+	return cylinder;
+}
+
+
+void Terrain_pool::end()
+{
+	for ( int i = _n_boxes ; i < _boxes.size() ; i++ )
+		_boxes[i]->set_geoms_enabled( false );
+	for ( int i = _n_spheres ; i < _spheres.size() ; i++ )
+		_spheres[i]->set_geoms_enabled( false );
+	for ( int i = _n_cylinders ; i < _cylinders.size() ; i++ )
+		_cylinders[i]->set_geoms_enabled( false );
+}
+
+
+void Terrain_pool::accept( ConstVisitor& v ) const
+{
+	for ( int i = 0 ; i < _n_boxes ; i++ )
+		_boxes[i]->accept( v );
+	for ( int i = 0 ; i < _n_spheres ; i++ )
+		_spheres[i]->accept( v );
+	for ( int i = 0 ; i < _n_cylinders ; i++ )
+		_cylinders[i]->accept( v );
+}
+
+
+}
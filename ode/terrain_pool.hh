@@ -0,0 +1,81 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TERRAIN_POOL_HH
+#define TERRAIN_POOL_HH
+
+#include <vector>
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include "box.hh"
+#include "sphere.hh"
+#include "cylinder.hh"
+
+
+namespace ode
+{
+
+
+/// Static obstacles reused from one scenario to the next. Each scenario is described between begin() and
+/// end(): the obstacles added take over the ones of the previous scenario, which are only moved, resized
+/// and enabled, and the remaining ones are disabled. New obstacles are only created when a scenario needs
+/// more of them than any previous one, so that the geoms stay in the collision space across episodes.
+/// The renderer places static objects once, so the scenario of a displayed scene must not change.
+class Terrain_pool
+{
+	public:
+
+	typedef boost::shared_ptr<Terrain_pool> ptr_t;
+
+	Terrain_pool( Environment& env, const char* collision_group = "ground" ) :
+	              _env( env ), _collision_group( collision_group ), _n_boxes( 0 ), _n_spheres( 0 ), _n_cylinders( 0 ), _n_created( 0 ) {}
+
+	void begin();
+
+	/// Box of dimensions l x w x h centred on pos:
+	Box& add_box( const Eigen::Vector3d& pos, double l, double w, double h, const Eigen::Quaterniond& q = Eigen::Quaterniond::Identity() );
+	Sphere& add_sphere( const Eigen::Vector3d& pos, double radius );
+	/// Cylinder of axis z in its own frame:
+	Cylinder& add_cylinder( const Eigen::Vector3d& pos, double radius, double length, const Eigen::Quaterniond& q = Eigen::Quaterniond::Identity() );
+
+	/// Disable the obstacles not used by the scenario.
+	void end();
+
+	/// Visit the obstacles of the current scenario.
+	void accept( ConstVisitor& v ) const;
+
+	inline int get_active_count() const { return _n_boxes + _n_spheres + _n_cylinders; }
+	/// Number of obstacles created since the construction of the pool:
+	inline size_t get_created_count() const { return _n_created; }
+
+	protected:
+
+	Environment& _env;
+	std::string _collision_group;
+	std::vector<boost::shared_ptr<Box>> _boxes;
+	std::vector<boost::shared_ptr<Sphere>> _spheres;
+	std::vector<boost::shared_ptr<Cylinder>> _cylinders;
+	int _n_boxes;
+	int _n_spheres;
+	int _n_cylinders;
+	size_t _n_created;
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,131 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ode/tiled_terrain.hh"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+
+namespace ode
+{
+
+
+Tiled_terrain::Tiled_terrain( Environment& env, const Eigen::Vector3d& pos, Tile_store::ptr_t store, double radius, int max_tiles,
+                              const char* collision_group ) :
+                              _env( env ), _pos( pos ), _store( store ), _radius( radius ), _max_tiles( max_tiles ),
+                              _collision_group( collision_group ), _n_loaded( 0 ), _n_evicted( 0 )
+{
+	if ( store->get_tile_cells() < 1 || store->get_resolution() <= 0 )
+		throw std::runtime_error( "Invalid tile store" );
+	_tiles.reserve( max_tiles );
+}
+
+
+void Tiled_terrain::update( const std::vector<Eigen::Vector3d>& positions )
+{
+	double size = _store->get_tile_size();
+
+	// Tiles overlapping the square around each position:
+	std::vector<std::pair<int,int>> needed;
+	for ( const Eigen::Vector3d& position : positions )
+	{
+		Eigen::Vector3d local = position - _pos;
+		int i_min = int( floor( ( local.x() - _radius )/size ) );
+		int i_max = int( floor( ( local.x() + _radius )/size ) );
+		int j_min = int( floor( ( local.y() - _radius )/size ) );
+		int j_max = int( floor( ( local.y() + _radius )/size ) );
+		for ( int i = i_min ; i <= i_max ; i++ )
+			for ( int j = j_min ; j <= j_max ; j++ )
+				if ( _store->has_tile( i, j ) )
+					needed.push_back( std::make_pair( i, j ) );
+	}
+	std::sort( needed.begin(), needed.end() );
+	needed.erase( std::unique( needed.begin(), needed.end() ), needed.end() );
+
+	if ( needed.size() > _max_tiles )
+		throw std::runtime_error( "Too many tiles required around the positions for the tiled terrain" );
+
+	// Evict the tiles no longer needed:
+	for ( int k = 0 ; k < _tiles.size() ; )
+		if ( ! std::binary_search( needed.begin(), needed.end(), std::make_pair( _tiles[k].i, _tiles[k].j ) ) )
+		{
+			_tiles[k].field.reset();
+			_free_buffers.push_back( std::move( _tiles[k].heights ) );
+			_tiles[k] = std::move( _tiles.back() );
+			_tiles.pop_back();
+			_n_evicted++;
+		}
+		else
+			k++;
+
+	// Load the missing ones:
+	for ( const std::pair<int,int>& tile : needed )
+	{
+		bool resident = false;
+		for ( const tile_t& resident_tile : _tiles )
+			if ( resident_tile.i == tile.first && resident_tile.j == tile.second )
+			{
+				resident = true;
+				break;
+			}
+		if ( ! resident )
+			_load( tile.first, tile.second );
+	}
+}
+
+
+void Tiled_terrain::_load( int i, int j )
+{
+	int n = _store->get_tile_cells() + 1;
+	double size = _store->get_tile_size();
+
+	tile_t tile;
+	tile.i = i;
+	tile.j = j;
+	if ( ! _free_buffers.empty() )
+	{
+		tile.heights = std::move( _free_buffers.back() );
+		_free_buffers.pop_back();
+	}
+	tile.heights.resize( n*n );
+	_store->load_tile( i, j, tile.heights.data() );
+
+	// Tight vertical bounds for the broadphase:
+	auto bounds = std::minmax_element( tile.heights.begin(), tile.heights.end() );
+
+	Eigen::Vector3d center = _pos + Eigen::Vector3d( ( i + 0.5 )*size, ( j + 0.5 )*size, 0 );
+	tile.field = Object::ptr_t( new HeightField( _env, center, tile.heights.data(), n, n, size, size, 0, *bounds.first, *bounds.second ) );
+	tile.field->set_collision_group( _collision_group.c_str() );
+
+	_tiles.push_back( std::move( tile ) );
+	_n_loaded++;
+}
+
+
+void Tiled_terrain::clear()
+{
+	for ( tile_t& tile : _tiles )
+	{
+		tile.field.reset();
+		_free_buffers.push_back( std::move( tile.heights ) );
+	}
+	_n_evicted += _tiles.size();
+	_tiles.clear();
+}
+
+
+}
@@ -0,0 +1,170 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TILED_TERRAIN_HH
+#define TILED_TERRAIN_HH
+
+#include <vector>
+#include <functional>
+#include <boost/shared_ptr.hpp>
+#include "heightfield.hh"
+#include "heightmap.hh"
+
+
+namespace ode
+{
+
+
+/// Source of the tiles of a Tiled_terrain. The tile (i, j) covers [i*size, (i+1)*size]x[j*size, (j+1)*size]
+/// in the frame of the terrain, where size = tile_cells*resolution, with tile_cells + 1 samples on each side.
+/// The samples on the border of a tile are at the same positions as those of its neighbours, so that the
+/// stores giving the height of each position give seamless tiles.
+class Tile_store
+{
+	public:
+
+	typedef boost::shared_ptr<Tile_store> ptr_t;
+
+	Tile_store( double resolution, int tile_cells ) : _resolution( resolution ), _tile_cells( tile_cells ) {}
+
+	virtual ~Tile_store() {}
+
+	inline double get_resolution() const { return _resolution; }
+	inline int get_tile_cells() const { return _tile_cells; }
+	inline double get_tile_size() const { return _tile_cells*_resolution; }
+
+	virtual bool has_tile( int i, int j ) const = 0;
+
+	/// Fill the (tile_cells + 1)^2 heights of a tile, laid out as expected by ode::HeightField (the row 0 at
+	/// the highest y, the column 0 at the lowest x).
+	virtual void load_tile( int i, int j, double* heights ) const = 0;
+
+	protected:
+
+	double _resolution;
+	int _tile_cells;
+};
+
+
+/// Tiles cut from a heightmap, whose lowest sample in x and y is at the origin of the terrain. A memory-mapped
+/// heightmap is only read by the system for the tiles loaded.
+class Heightmap_tile_store : public Tile_store
+{
+	public:
+
+	Heightmap_tile_store( Heightmap::ptr_t heightmap, double resolution, int tile_cells ) :
+	                      Tile_store( resolution, tile_cells ), _heightmap( heightmap ) {}
+
+	virtual bool has_tile( int i, int j ) const
+	{
+		return i >= 0 && j >= 0 && ( i + 1 )*_tile_cells < _heightmap->get_cols() && ( j + 1 )*_tile_cells < _heightmap->get_rows();
+	}
+
+	virtual void load_tile( int i, int j, double* heights ) const
+	{
+		int n = _tile_cells + 1;
+		int top_row = _heightmap->get_rows() - 1 - ( j + 1 )*_tile_cells;
+		for ( int r = 0 ; r < n ; r++ )
+			for ( int c = 0 ; c < n ; c++ )
+				heights[r*n + c] = _heightmap->get_height( top_row + r, i*_tile_cells + c );
+	}
+
+	protected:
+
+	Heightmap::ptr_t _heightmap;
+};
+
+
+/// Tiles sampled from a height function of the position in the frame of the terrain, unbounded.
+class Function_tile_store : public Tile_store
+{
+	public:
+
+	Function_tile_store( std::function<double(double,double)> height, double resolution, int tile_cells ) :
+	                     Tile_store( resolution, tile_cells ), _height( height ) {}
+
+	virtual bool has_tile( int i, int j ) const { return true; }
+
+	virtual void load_tile( int i, int j, double* heights ) const
+	{
+		int n = _tile_cells + 1;
+		for ( int r = 0 ; r < n ; r++ )
+			for ( int c = 0 ; c < n ; c++ )
+				heights[r*n + c] = _height( ( i*_tile_cells + c )*_resolution, ( ( j + 1 )*_tile_cells - r )*_resolution );
+	}
+
+	protected:
+
+	std::function<double(double,double)> _height;
+};
+
+
+/// Terrain streamed by tiles from a Tile_store: only the tiles within a radius of the given positions (the
+/// rovers for instance) are resident as heightfield geoms. The tiles are loaded and evicted by update(), and
+/// their buffers are recycled, so that the memory used only depends on the radius and the number of positions.
+/// The tiles are not drawn by the renderer, which only visits the objects existing when it is built.
+class Tiled_terrain
+{
+	public:
+
+	typedef boost::shared_ptr<Tiled_terrain> ptr_t;
+
+	/// pos is the position of the origin of the tiles in the environment. max_tiles bounds the number of
+	/// resident tiles: update() throws if more tiles are required.
+	Tiled_terrain( Environment& env, const Eigen::Vector3d& pos, Tile_store::ptr_t store, double radius, int max_tiles = 64,
+	               const char* collision_group = "ground" );
+
+	/// Load the tiles within the radius of any of the positions and evict the others.
+	void update( const std::vector<Eigen::Vector3d>& positions );
+
+	/// Evict every tile.
+	void clear();
+
+	inline int get_resident_tiles() const { return _tiles.size(); }
+	inline size_t get_loaded_tiles() const { return _n_loaded; }
+	inline size_t get_evicted_tiles() const { return _n_evicted; }
+
+	~Tiled_terrain() { clear(); }
+
+	protected:
+
+	typedef struct tile_t
+	{
+		int i, j;
+		std::vector<double> heights;
+		Object::ptr_t field;
+	} tile_t;
+
+	void _load( int i, int j );
+
+	Environment& _env;
+	Eigen::Vector3d _pos;
+	Tile_store::ptr_t _store;
+	double _radius;
+	int _max_tiles;
+	std::string _collision_group;
+	std::vector<tile_t> _tiles;
+	// Buffers of the evicted tiles, reused for the next ones:
+	std::vector<std::vector<double>> _free_buffers;
+	size_t _n_loaded;
+	size_t _n_evicted;
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,231 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ode/trimesh.hh"
+#include <boost/weak_ptr.hpp>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <array>
+#include <map>
+#include <mutex>
+
+
+namespace ode
+{
+
+
+static std::mutex _registry_mutex;
+static std::map<uint64_t,boost::weak_ptr<Trimesh_data>> _registry;
+
+
+static uint64_t _fnv1a( const std::string& data )
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for ( unsigned char byte : data )
+	{
+		hash ^= byte;
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+
+Trimesh_data::ptr_t Trimesh_data::load_obj( const std::string& path )
+{
+	std::ifstream file( path, std::ios::binary );
+	if ( ! file )
+		throw std::runtime_error( std::string( "Can't open " ) + path );
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	std::string content = buffer.str();
+	uint64_t hash = _fnv1a( content );
+
+	std::lock_guard<std::mutex> lock( _registry_mutex );
+
+	auto it = _registry.find( hash );
+	if ( it != _registry.end() )
+	{
+		ptr_t mesh = it->second.lock();
+		if ( mesh )
+			return mesh;
+	}
+
+	// Cache file in the directory of the mesh:
+	size_t slash = path.find_last_of( '/' );
+	char name[32];
+	snprintf( name, sizeof( name ), "%016llx", ( unsigned long long ) hash );
+	std::string cache_path = ( slash == std::string::npos ? std::string() : path.substr( 0, slash + 1 ) ) + name + TRIMESH_EXTENSION;
+
+	std::vector<double> vertices;
+	std::vector<dTriIndex> indices;
+	if ( ! _read_cache( cache_path, hash, vertices, indices ) )
+	{
+		_parse_obj( content, vertices, indices );
+		if ( indices.empty() )
+			throw std::runtime_error( std::string( "No triangle in " ) + path );
+		// A read-only directory only prevents the caching:
+		try
+		{
+			_write_cache( cache_path, hash, vertices, indices );
+		}
+		catch ( const std::runtime_error& e )
+		{
+			std::cerr << e.what() << std::endl;
+		}
+	}
+
+	ptr_t mesh( new Trimesh_data( hash, vertices, indices ) );
+	_registry[hash] = mesh;
+
+	return mesh;
+}
+
+
+Trimesh_data::Trimesh_data( uint64_t hash, std::vector<double>& vertices, std::vector<dTriIndex>& indices ) : _hash( hash )
+{
+	_vertices.swap( vertices );
+	_indices.swap( indices );
+
+	_id = dGeomTriMeshDataCreate();
+	dGeomTriMeshDataBuildDouble( _id, _vertices.data(), 3*sizeof( double ), _vertices.size()/3,
+	                             _indices.data(), _indices.size(), 3*sizeof( dTriIndex ) );
+	dGeomTriMeshDataPreprocess( _id );
+}
+
+
+Trimesh_data::~Trimesh_data()
+{
+	dGeomTriMeshDataDestroy( _id );
+}
+
+
+void Trimesh_data::_parse_obj( const std::string& content, std::vector<double>& vertices, std::vector<dTriIndex>& indices )
+{
+	std::vector<std::array<double,3>> obj_vertices;
+	// Index of each OBJ vertex among the merged vertices:
+	std::vector<dTriIndex> merged_index;
+	std::map<std::array<double,3>,dTriIndex> merged;
+
+	std::istringstream stream( content );
+	std::string line;
+	while ( std::getline( stream, line ) )
+	{
+		std::istringstream line_stream( line );
+		std::string keyword;
+		line_stream >> keyword;
+
+		if ( keyword == "v" )
+		{
+			std::array<double,3> v;
+			line_stream >> v[0] >> v[1] >> v[2];
+			obj_vertices.push_back( v );
+
+			auto it = merged.find( v );
+			if ( it == merged.end() )
+			{
+				it = merged.insert( std::make_pair( v, dTriIndex( vertices.size()/3 ) ) ).first;
+				vertices.insert( vertices.end(), v.begin(), v.end() );
+			}
+			merged_index.push_back( it->second );
+		}
+		else if ( keyword == "f" )
+		{
+			// Vertex references of the form i, i/t, i//n or i/t/n, negative ones being relative to the end:
+			std::vector<dTriIndex> face;
+			std::string token;
+			while ( line_stream >> token )
+			{
+				long i = strtol( token.c_str(), nullptr, 10 );
+				if ( i < 0 )
+					i += obj_vertices.size() + 1;
+				if ( i < 1 || i > obj_vertices.size() )
+					throw std::runtime_error( "Invalid vertex index in OBJ face: " + line );
+				face.push_back( merged_index[i - 1] );
+			}
+
+			// Fan triangulation, without the degenerated triangles:
+			for ( int k = 1 ; k + 1 < face.size() ; k++ )
+				if ( face[0] != face[k] && face[k] != face[k + 1] && face[0] != face[k + 1] )
+				{
+					indices.push_back( face[0] );
+					indices.push_back( face[k] );
+					indices.push_back( face[k + 1] );
+				}
+		}
+	}
+}
+
+
+bool Trimesh_data::_read_cache( const std::string& path, uint64_t hash, std::vector<double>& vertices, std::vector<dTriIndex>& indices )
+{
+	FILE* file = fopen( path.c_str(), "rb" );
+	if ( file == nullptr )
+		return false;
+
+	trimesh_header_t header;
+	bool valid = ( fread( &header, sizeof( header ), 1, file ) == 1 )
+	             && memcmp( header.magic, TRIMESH_MAGIC, sizeof( header.magic ) ) == 0
+	             && header.hash == hash;
+	if ( valid )
+	{
+		vertices.resize( 3*size_t( header.n_vertices ) );
+		std::vector<uint32_t> file_indices( 3*size_t( header.n_triangles ) );
+		valid = ( fread( vertices.data(), sizeof( double ), vertices.size(), file ) == vertices.size() )
+		        && ( fread( file_indices.data(), sizeof( uint32_t ), file_indices.size(), file ) == file_indices.size() );
+		indices.assign( file_indices.begin(), file_indices.end() );
+	}
+	fclose( file );
+
+	if ( ! valid )
+	{
+		vertices.clear();
+		indices.clear();
+	}
+	return valid;
+}
+
+
+void Trimesh_data::_write_cache( const std::string& path, uint64_t hash, const std::vector<double>& vertices, const std::vector<dTriIndex>& indices )
+{
+	trimesh_header_t header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, TRIMESH_MAGIC, sizeof( header.magic ) );
+	header.hash = hash;
+	header.n_vertices = vertices.size()/3;
+	header.n_triangles = indices.size()/3;
+	std::vector<uint32_t> file_indices( indices.begin(), indices.end() );
+
+	// Write a temporary file and move it in place, so that a concurrent reader never gets a partial file:
+	std::string tmp_path = path + ".tmp";
+	FILE* file = fopen( tmp_path.c_str(), "wb" );
+	if ( file == nullptr )
+		throw std::runtime_error( std::string( "Can't write " ) + tmp_path );
+	bool written = ( fwrite( &header, sizeof( header ), 1, file ) == 1 )
+	               && ( fwrite( vertices.data(), sizeof( double ), vertices.size(), file ) == vertices.size() )
+	               && ( fwrite( file_indices.data(), sizeof( uint32_t ), file_indices.size(), file ) == file_indices.size() );
+	written = ( fclose( file ) == 0 ) && written;
+	if ( ! written || rename( tmp_path.c_str(), path.c_str() ) != 0 )
+	{
+		remove( tmp_path.c_str() );
+		throw std::runtime_error( std::string( "Can't write " ) + path );
+	}
+}
+
+
+}
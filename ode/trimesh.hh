@@ -0,0 +1,85 @@
+/*
+** Copyright (C) 2019 Arthur BOUTON
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, version 3.
+**
+** This program is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRIMESH_HH
+#define TRIMESH_HH
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include "environment.hh"
+
+
+namespace ode
+{
+
+
+// Header of a mesh cache file, followed by the n_vertices*3 coordinates (double) and the n_triangles*3
+// indices (uint32_t), in the byte order of the machine that wrote it:
+typedef struct trimesh_header_t
+{
+	char magic[8];
+	uint64_t hash;
+	uint32_t n_vertices;
+	uint32_t n_triangles;
+} trimesh_header_t;
+
+#define TRIMESH_MAGIC "TMSH0001"
+#define TRIMESH_EXTENSION ".trimesh"
+
+
+/// Triangle mesh for collision, loaded from a Wavefront OBJ file. The faces are triangulated and the
+/// duplicated vertices are merged once per mesh: the result is cached on disk next to the OBJ file, in a
+/// file named after the FNV-1a hash of its content, so that a modified mesh gets a new cache. In memory, the
+/// meshes are shared by hash, with their ODE data and its collision tree built once for every geom and
+/// environment using them.
+class Trimesh_data
+{
+	public:
+
+	typedef boost::shared_ptr<Trimesh_data> ptr_t;
+
+	static ptr_t load_obj( const std::string& path );
+
+	~Trimesh_data();
+
+	inline dTriMeshDataID get_id() const { return _id; }
+	inline uint64_t get_hash() const { return _hash; }
+	inline int get_vertex_count() const { return _vertices.size()/3; }
+	inline int get_triangle_count() const { return _indices.size()/3; }
+	inline const std::vector<double>& get_vertices() const { return _vertices; }
+	inline const std::vector<dTriIndex>& get_indices() const { return _indices; }
+
+	protected:
+
+	Trimesh_data( uint64_t hash, std::vector<double>& vertices, std::vector<dTriIndex>& indices );
+
+	static void _parse_obj( const std::string& content, std::vector<double>& vertices, std::vector<dTriIndex>& indices );
+	static bool _read_cache( const std::string& path, uint64_t hash, std::vector<double>& vertices, std::vector<dTriIndex>& indices );
+	static void _write_cache( const std::string& path, uint64_t hash, const std::vector<double>& vertices, const std::vector<dTriIndex>& indices );
+
+	uint64_t _hash;
+	std::vector<double> _vertices;
+	std::vector<dTriIndex> _indices;
+	dTriMeshDataID _id;
+};
+
+
+}
+
+
+#endif
@@ -24,22 +24,69 @@
 namespace ode
 {
 
+
+typedef enum tire_model_t
+{
+	SPHERES_TIRE, // Rim cylinder surrounded by def sphere geoms acting as lugs
+	CYLINDER_TIRE // Single cylinder geom with soft contacts computed from the stiffness and damping of the tire
+} tire_model_t;
+
+
 class Wheel : public Object
 {
 	public:
 
 	static constexpr double standard_mass = 1;
+	// Vertical stiffness and damping of the cylinder tire, giving the soft ERP and CFM of SOFT contacts at 1 ms:
+	static constexpr double tire_kp = 80000; // N/m
+	static constexpr double tire_kd = 120; // N.s/m
 
 	Wheel( Environment& env, const Eigen::Vector3d& pos, double mass, double radius, double width, int def,
-	       bool casts_shadow = true ) :
-	       Object( env, pos ), _mass( mass ), _radius( radius - width/2 ), _width( width ), _def( def )
+	       bool casts_shadow = true, tire_model_t tire_model = SPHERES_TIRE ) :
+	       Object( env, pos ), _mass( mass ), _radius( radius - width/2 ), _width( width ), _def( def ), _tire_model( tire_model ),
+	       _window_half_angle( 0 )
 	{
-		if ( def == 0 )
+		if ( tire_model == CYLINDER_TIRE )
+			_def = 0;
+		if ( _def == 0 )
 			_radius = radius;
 		_casts_shadow = casts_shadow;
 		init();
 	}
 
+	tire_model_t get_tire_model() const { return _tire_model; }
+
+	/// Enable only the tire spheres within half_angle (in radians) of the downward direction, so that the
+	/// others are skipped by the broadphase. The window follows the wheel through update_contact_window.
+	/// A half-angle of 0 enables all the spheres.
+	void set_contact_window( double half_angle )
+	{
+		_window_half_angle = half_angle;
+		update_contact_window();
+	}
+
+	void update_contact_window()
+	{
+		double down_angle( 0 );
+		if ( _window_half_angle > 0 )
+		{
+			// Downward direction in the plane of the wheel:
+			dVector3 down;
+			dBodyVectorFromWorld( _body, 0, 0, -1, down );
+			down_angle = atan2( down[1], down[0] );
+		}
+
+		for ( int i = 0 ; i < _def ; i++ )
+		{
+			dGeomID tire = _geoms[1 + i];
+			bool enabled = ( _window_half_angle <= 0 || fabs( remainder( i*2*M_PI/_def - down_angle, 2*M_PI ) ) <= _window_half_angle );
+			if ( enabled && ! dGeomIsEnabled( tire ) )
+				dGeomEnable( tire );
+			else if ( ! enabled && dGeomIsEnabled( tire ) )
+				dGeomDisable( tire );
+		}
+	}
+
 	double get_radius() const { return _radius; }
 	double get_width() const { return _width; }
 	double get_def() const { return _def; }
@@ -62,12 +109,16 @@ class Wheel : public Object
 
 		dGeomID rim = dCreateCylinder( _env.get_space(), _radius, _width );
 		dGeomSetBody( rim, _body );
+		_env.set_collision_bits( rim );
 		_geoms.push_back( rim );
+		if ( _tire_model == CYLINDER_TIRE )
+			set_contact_stiffness( tire_kp, tire_kd );
 
 		for ( int i = 0 ; i < _def ; i++ )
 		{
 			dGeomID tire = dCreateSphere( _env.get_space(), _width/2 );
 			dGeomSetBody( tire, _body );
+			_env.set_collision_bits( tire );
 			dGeomSetOffsetPosition( tire, _radius*cos( i*2*M_PI/_def ), _radius*sin( i*2*M_PI/_def ), 0 );
 			_geoms.push_back( tire );
 		}
@@ -77,6 +128,8 @@ class Wheel : public Object
 	double _radius;
 	double _width;
 	int _def;
+	tire_model_t _tire_model;
+	double _window_half_angle;
 };
 
 }
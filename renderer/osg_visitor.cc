@@ -190,8 +190,19 @@ void OsgVisitor::_create_std_object( const ode::Object& o, ShapeDrawable* drawab
 		pat->addChild( pLoadedModel );
 	}
 
-	ref_ptr<NodeCallback> cb( new UpdateCallback( o ) );
-	pat->setUpdateCallback( cb );
+	if ( o.is_static() )
+	{
+		// Static geometry is placed once:
+		Eigen::Vector3d pos = o.get_pos();
+		Eigen::Quaterniond q = o.get_quaternion();
+		pat->setPosition( Vec3( pos.x(), pos.y(), pos.z() ) );
+		pat->setAttitude( Quat( q.x(), q.y(), q.z(), q.w() ) );
+	}
+	else
+	{
+		ref_ptr<NodeCallback> cb( new UpdateCallback( o ) );
+		pat->setUpdateCallback( cb );
+	}
 
 	_root->addChild( pat );
 	_set_tm( pat );
@@ -297,7 +308,6 @@ void OsgVisitor::visit( const ode::HeightField& o )
 	if ( !o.casts_shadow() )
 		geode->setNodeMask( geode->getNodeMask() & ~CASTS_SHADOW );
 
-	double* data = o.data;
 	int nrow = o.nrow;
 	int ncol = o.ncol;
 	double length = o.length;
@@ -313,7 +323,7 @@ void OsgVisitor::visit( const ode::HeightField& o )
 
 	for ( int r = 0 ; r < nrow ; r++ )
 		for ( int c = 0 ; c < ncol ; c++ )
-			heightField->setHeight( c, r, *( data + ( nrow - r - 1 )*ncol + c ) );
+			heightField->setHeight( c, r, o.get_height( nrow - r - 1, c ) );
 
 	ShapeDrawable* drawable = new osg::ShapeDrawable( heightField );
 	//_set_object_color( drawable, o );
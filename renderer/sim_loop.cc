@@ -15,11 +15,13 @@
 */
 
 #include "sim_loop.hh"
+#include <algorithm>
 
 
 Sim_loop::Sim_loop( float timestep, renderer::OsgVisitor* display_ptr, bool print_time, int log_level ) :
                     _timestep( timestep ), _display_ptr( display_ptr ), _log_level( log_level ), _time( 0 ),
-					_print_time( print_time ), _nsec( 0 ), _is_paused( false ), _warp_factor( 1 )
+					_print_time( print_time ), _nsec( 0 ), _is_paused( false ), _warp_factor( 1 ),
+					_max_multiple( 1 ), _multiple( 1 ), _calm_steps( 0 )
 {
 	if ( _display_ptr != nullptr )
 	{
@@ -104,6 +106,50 @@ void Sim_loop::_do_print_time()
 }
 
 
+void Sim_loop::set_adaptive_timestep( unsigned int max_multiple, std::function<double(void)> error, std::function<double(void)> horizon )
+{
+	_max_multiple = std::max( 1u, max_multiple );
+	_multiple = 1;
+	_calm_steps = 0;
+	_error = error;
+	_horizon = horizon;
+}
+
+
+unsigned int Sim_loop::_next_multiple()
+{
+	if ( _max_multiple == 1 )
+		return 1;
+
+	double error = _error();
+	if ( error > 1 )
+	{
+		_multiple = 1;
+		_calm_steps = 0;
+	}
+	else if ( error < 0.5 && ++_calm_steps >= ADAPTIVE_GROWTH_DELAY )
+	{
+		_multiple = std::min( 2*_multiple, _max_multiple );
+		_calm_steps = 0;
+	}
+
+	unsigned int k = _multiple;
+
+	if ( _horizon )
+	{
+		double horizon = _horizon();
+		while ( k > 1 && k*_timestep > horizon + 1e-6 )
+			k /= 2;
+	}
+
+	if ( _display_ptr != nullptr && _capture )
+		while ( k > 1 && _step_counter_c % _capture_rate + k > _capture_rate )
+			k /= 2;
+
+	return k;
+}
+
+
 void Sim_loop::loop( std::function<bool(float,double)> step_function )
 {
 	if ( _display_ptr != nullptr )
@@ -163,7 +209,9 @@ void Sim_loop::loop( std::function<bool(float,double)> step_function )
 					if ( _print_time )
 						_do_print_time();
 
-					if ( step_function( _timestep, _time*_timestep ) )
+					unsigned int k = _next_multiple();
+
+					if ( step_function( k*_timestep, _time*_timestep ) )
 						break;
 
 					if ( _capture )
@@ -175,12 +223,12 @@ void Sim_loop::loop( std::function<bool(float,double)> step_function )
 							_display_ptr->update();
 							osgDB::writeImageFile( *_image, image_path );
 						}
-						_step_counter_c++;
+						_step_counter_c += k;
 					}
 
-					_step_counter_u++;
+					_step_counter_u += k;
 
-					_time++;
+					_time += k;
 				}
 				else
 				{
@@ -208,10 +256,12 @@ void Sim_loop::loop( std::function<bool(float,double)> step_function )
 			if ( _print_time )
 				_do_print_time();
 
-			if ( step_function( _timestep, _time*_timestep ) )
+			unsigned int k = _next_multiple();
+
+			if ( step_function( k*_timestep, _time*_timestep ) )
 				break;
 
-			_time++;
+			_time += k;
 		}
 	}
 }
@@ -28,6 +28,7 @@
 #define DEFAULT_TIMESTEP 0.001 // Seconds
 #define DEFAULT_FPS 25 // Frames per second
 #define DEFAULT_CAPTURE_PATH "/tmp/robdyn_%05d.bmp"
+#define ADAPTIVE_GROWTH_DELAY 10 // Steps with a low error before doubling the timestep
 
 
 class Sim_loop
@@ -40,9 +41,20 @@ class Sim_loop
 
 	inline void set_fps( int fps ) { _fps = fps; _ufperiod = 1e6/_fps; }
 	inline double get_time() const { return _time*_timestep; }
+	/// Start the simulated time at time (in s), to resume a simulation from a saved state:
+	inline void set_time( double time ) { _time = lround( time/_timestep ); }
 
 	inline void set_timewarp( float warp_factor ) { _utimestep = _timestep*1e6/warp_factor; }
 
+	/// Adaptive mode: each step lasts k timesteps, k being a power of two up to max_multiple.
+	/// error() is evaluated before each step: above 1, k falls back to 1, and after ADAPTIVE_GROWTH_DELAY
+	/// steps below 0.5, k is doubled. horizon(), if set, returns the simulated time left before the next
+	/// event that must be reached exactly (a control tick for instance): no step goes past it. Captures
+	/// stay aligned as well. step_function receives the duration of each step and the time at its start.
+	void set_adaptive_timestep( unsigned int max_multiple, std::function<double(void)> error,
+	                            std::function<double(void)> horizon = nullptr );
+	inline unsigned int get_step_multiple() const { return _multiple; }
+
 	virtual void set_fps_captures( int fps );
 	virtual void start_captures( const char* path = DEFAULT_CAPTURE_PATH );
 	virtual void stop_captures();
@@ -53,6 +65,7 @@ class Sim_loop
 
 	virtual void _update_chrono();
 	virtual void _do_print_time();
+	virtual unsigned int _next_multiple();
 
 	float _timestep;
 	long _time;
@@ -82,6 +95,12 @@ class Sim_loop
 
 	float _warp_factor;
 	renderer::OsgText::ptr_t _warp_text;
+
+	unsigned int _max_multiple;
+	unsigned int _multiple;
+	unsigned int _calm_steps;
+	std::function<double(void)> _error;
+	std::function<double(void)> _horizon;
 };
 
 
@@ -53,10 +53,12 @@ def critic( s_dim, a_dim ) :
 # Parameters for the training:
 EP_MAX = 100000 # Maximal number of episodes for the training
 ITER_PER_EP = 200 # Number of training iterations between each episode
+TRIALS_PER_EP = 1 # Number of trials simulated in parallel for each episode
+WHEEL_TORQUES = False # Append the torques of the 4 wheels to the state
 hyper_params = {}
-hyper_params['s_dim'] = 17 # Dimension of the state space
+hyper_params['s_dim'] = 17 + ( 4 if WHEEL_TORQUES else 0 ) # Dimension of the state space
 hyper_params['a_dim'] = 2 # Dimension of the action space
-hyper_params['state_scale'] = [ 90, 45, 25, 25, 45 ] + ( [ 100 ]*3 + [ 30 ]*3 )*2 # A scalar or a vector to normalize the state
+hyper_params['state_scale'] = [ 90, 45, 25, 25, 45 ] + ( [ 100 ]*3 + [ 30 ]*3 )*2 + ( [ 25 ]*4 if WHEEL_TORQUES else [] ) # A scalar or a vector to normalize the state
 hyper_params['action_scale'] = [ 15, 25 ] # A scalar or a vector to scale the actions
 hyper_params['gamma'] = 0.99 # Discount factor applied to the reward
 #hyper_params['tau'] = 5e-3 # Soft target update factor
@@ -95,6 +97,12 @@ np.random.seed( hyper_params['seed'] )
 n_ep = 0
 LQ = 0
 
+# Simulation kept alive between the episodes:
+if TRIALS_PER_EP == 1 :
+	sim_session = rover_training_1_module.Session( session_dir + '/actor', True, WHEEL_TORQUES )
+else :
+	rover_training_1_module.set_wheel_torque_sensing( WHEEL_TORQUES )
+
 import time
 start = time.time()
 
@@ -103,8 +111,12 @@ with Loop_handler() as interruption :
 	while not interruption() and n_ep < EP_MAX :
 
 
-		# Do one trial:
-		trial_experience = rover_training_1_module.trial( session_dir + '/actor' )
+		# Do one trial, or a batch of trials in parallel:
+		if TRIALS_PER_EP > 1 :
+			trial_experience = rover_training_1_module.trial_batch( session_dir + '/actor', TRIALS_PER_EP )
+		else :
+			sim_session.reset_random()
+			trial_experience = sim_session.run_episode()
 
 		if interruption() :
 			break
@@ -112,13 +124,15 @@ with Loop_handler() as interruption :
 		# Store the experience:
 		td3.replay_buffer.extend( trial_experience )
 
-		n_ep += 1
+		n_ep += TRIALS_PER_EP
 
 
 		# Train the networks:
 		LQ = td3.train( ITER_PER_EP )
 
 		td3.actor.save( session_dir + '/actor' )
+		if TRIALS_PER_EP == 1 :
+			sim_session.reload_actor( session_dir + '/actor' )
 
 		print( 'It %i | Ep %i | Bs %i | LQ %+7.4f' %
 			   ( td3.n_iter, n_ep, len( td3.replay_buffer ), LQ ), flush=True )
@@ -0,0 +1,144 @@
+/*
+** Benchmark of the collision detection with the different broadphase spaces.
+**
+** A Rover_1 drives towards the step of rover_training_1 next to a field of fixed rocks.
+** For each space configuration, the time spent in Environment::collide() is measured
+** separately from the integration of the dynamics.
+**
+** First argument (optional):
+** Number of simulation steps per configuration (default: 10000).
+**
+** Second argument (optional):
+** Number of rocks in the field (default: 100).
+*/
+
+#include "ode/environment.hh"
+#include "rover.hh"
+#include "ode/box.hh"
+#include <chrono>
+#include <random>
+
+
+typedef struct bench_config_t
+{
+	const char* name;
+	ode::space_config_t space;
+	bool nested;
+} bench_config_t;
+
+
+void bench( const bench_config_t& config, int n_steps, int n_rocks )
+{
+	const double timestep( 0.001 );
+
+
+	// [ Dynamic environment ]
+
+	ode::Environment env( config.space, true, 0.5 );
+
+
+	// [ Robot ]
+
+	robot::Rover_1 robot( env, Eigen::Vector3d( 0, 0, 0 ) );
+	robot.DeactivateIC();
+	robot.SetCrawlingMode( true );
+	if ( config.nested )
+		robot.set_own_space( env );
+
+
+	// [ Terrain ]
+
+	float step_height( 0.105*2 );
+	ode::Box step( env, Eigen::Vector3d( 1, 0, step_height/2 ), 1, 1, 3, step_height, false );
+	step.make_static();
+	step.set_collision_group( "ground" );
+
+	ode::Box step_c( env, Eigen::Vector3d( 2, 0, step_height/2 ), 1, 2, 3, step_height, false );
+	step_c.make_static();
+	step_c.set_collision_group( "ground" );
+
+	// Rocks scattered on both sides of the track, the same for every configuration:
+	std::mt19937 gen( 0 );
+	std::uniform_real_distribution<double> uniform( 0, 1 );
+	std::vector<ode::Object::ptr_t> rocks;
+	for ( int i = 0 ; i < n_rocks ; i++ )
+	{
+		double size = 0.05 + 0.1*uniform( gen );
+		double y = ( i % 2 == 0 ? 1 : -1 )*( 0.8 + 2*uniform( gen ) );
+		ode::Object::ptr_t rock( new ode::Box( env, Eigen::Vector3d( -1 + 4*uniform( gen ), y, size/2 ), 1, size, size, size, false ) );
+		rock->make_static();
+		rock->set_collision_group( "ground" );
+		rocks.push_back( rock );
+	}
+
+
+	// [ Simulation loop ]
+
+	std::chrono::duration<double> collide_time( 0 );
+	std::chrono::duration<double> total_time( 0 );
+
+	float speed = 0;
+	for ( int i = 0 ; i < n_steps ; i++ )
+	{
+		if ( speed < 0.04 )
+		{
+			speed += 0.04/0.5*timestep;
+			robot.SetRobotSpeed( speed );
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		env.collide( timestep );
+		auto collided = std::chrono::steady_clock::now();
+		env.integrate( timestep );
+		robot.next_step( timestep );
+		auto end = std::chrono::steady_clock::now();
+
+		collide_time += collided - start;
+		total_time += end - start;
+	}
+
+	printf( "%-28s %12.0f %12.0f %10.3f\n", config.name, n_steps/collide_time.count(), n_steps/total_time.count(), robot.GetPosition().x() );
+}
+
+
+int main( int argc, char* argv[] )
+{
+	int n_steps( 10000 );
+	if ( argc > 1 )
+		n_steps = atoi( argv[1] );
+	int n_rocks( 100 );
+	if ( argc > 2 )
+		n_rocks = atoi( argv[2] );
+
+	dInitODE();
+
+	std::vector<bench_config_t> configs;
+
+	configs.push_back( { "hash", ode::space_config_t( ode::HASH_SPACE ), false } );
+	configs.push_back( { "hash, nested", ode::space_config_t( ode::HASH_SPACE ), true } );
+
+	// Cells from 3 cm (tire spheres) to 4 m (steps):
+	ode::space_config_t tuned_hash( ode::HASH_SPACE );
+	tuned_hash.hash_min_level = -5;
+	tuned_hash.hash_max_level = 2;
+	configs.push_back( { "hash (-5,2), nested", tuned_hash, true } );
+
+	configs.push_back( { "SAP, nested", ode::space_config_t( ode::SAP_SPACE ), true } );
+
+	ode::space_config_t quadtree( ode::QUADTREE_SPACE );
+	quadtree.center = Eigen::Vector3d( 1, 0, 0 );
+	quadtree.extents = Eigen::Vector3d( 8, 8, 2 );
+	quadtree.depth = 5;
+	configs.push_back( { "quadtree, nested", quadtree, true } );
+
+	configs.push_back( { "simple, nested", ode::space_config_t( ode::SIMPLE_SPACE ), true } );
+
+	printf( "%d steps, %d rocks\n", n_steps, n_rocks );
+	printf( "%-28s %12s %12s %10s\n", "space", "collide/s", "steps/s", "final x" );
+	for ( const bench_config_t& config : configs )
+		bench( config, n_steps, n_rocks );
+
+	dCloseODE();
+
+	return 0;
+}
@@ -0,0 +1,110 @@
+/*
+** Benchmark of the multi-threaded stepping of the islands of an environment.
+**
+** Several Rover_1 drive side by side towards a common step. Each rover forms its own
+** island of bodies, so that the islands can be stepped in parallel. The same scene is
+** run with 1 to 16 stepping threads (Environment::set_step_threads).
+**
+** First argument (optional):
+** Number of rovers (default: 8).
+**
+** Second argument (optional):
+** Number of simulation steps per configuration (default: 5000).
+*/
+
+#include "ode/environment.hh"
+#include "rover.hh"
+#include "ode/box.hh"
+#include <chrono>
+
+
+// Return the number of steps per second and the time spent in the integration only:
+double run( unsigned int n_threads, int n_rovers, int n_steps, double& integration_time )
+{
+	const double timestep( 0.001 );
+
+
+	// [ Dynamic environment ]
+
+	ode::Environment env( 0.5 );
+	env.set_step_threads( n_threads );
+
+
+	// [ Robots ]
+
+	double spacing( 1.2 );
+	std::vector<robot::Robot::ptr_t> robots;
+	for ( int i = 0 ; i < n_rovers ; i++ )
+	{
+		robot::Rover_1* rover = new robot::Rover_1( env, Eigen::Vector3d( 0, ( i - 0.5*( n_rovers - 1 ) )*spacing, 0 ) );
+		rover->DeactivateIC();
+		rover->SetCrawlingMode( true );
+		rover->SetRobotSpeed( 0.04 );
+		rover->set_own_space( env );
+		robots.push_back( robot::Robot::ptr_t( rover ) );
+	}
+
+
+	// [ Terrain ]
+
+	float step_height( 0.105*2 );
+	ode::Box step( env, Eigen::Vector3d( 1, 0, step_height/2 ), 1, 1, n_rovers*spacing + 1, step_height, false );
+	step.make_static();
+	step.set_collision_group( "ground" );
+
+
+	// [ Simulation loop ]
+
+	std::chrono::duration<double> integration( 0 );
+
+	auto start = std::chrono::steady_clock::now();
+	for ( int i = 0 ; i < n_steps ; i++ )
+	{
+		env.collide( timestep );
+		auto collided = std::chrono::steady_clock::now();
+		env.integrate( timestep );
+		integration += std::chrono::steady_clock::now() - collided;
+
+		for ( robot::Robot::ptr_t robot : robots )
+			robot->next_step( timestep );
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	integration_time = integration.count();
+
+	return n_steps/elapsed.count();
+}
+
+
+int main( int argc, char* argv[] )
+{
+	int n_rovers( 8 );
+	if ( argc > 1 )
+		n_rovers = atoi( argv[1] );
+	int n_steps( 5000 );
+	if ( argc > 2 )
+		n_steps = atoi( argv[2] );
+
+	dInitODE2( 0 );
+	dAllocateODEDataForThread( dAllocateMaskAll );
+
+	printf( "%d rovers, %d steps\n", n_rovers, n_steps );
+	printf( "%8s %10s %10s %16s %18s\n", "threads", "steps/s", "speedup", "integration (s)", "integration speedup" );
+
+	double reference_rate( 0 ), reference_integration( 0 );
+	for ( unsigned int n_threads : { 1, 2, 4, 8, 16 } )
+	{
+		double integration_time;
+		double rate = run( n_threads, n_rovers, n_steps, integration_time );
+		if ( n_threads == 1 )
+		{
+			reference_rate = rate;
+			reference_integration = integration_time;
+		}
+		printf( "%8u %10.0f %10.2f %16.3f %18.2f\n", n_threads, rate, rate/reference_rate, integration_time, reference_integration/integration_time );
+	}
+
+	dCloseODE();
+
+	return 0;
+}
@@ -0,0 +1,136 @@
+/*
+** Benchmark of the step solvers on the step scenario of rover_training_1.
+**
+** The rover drives at cruise speed in crawling mode towards the step. Each solver
+** configuration is compared to the trajectory obtained with dWorldStep, in terms of
+** simulation steps per second and deviation of the position of the rover.
+**
+** First argument (optional):
+** Simulated duration in seconds (default: 20).
+**
+** Second argument (optional):
+** Orientation of the step in degrees (default: 0).
+*/
+
+#include "ode/environment.hh"
+#include "rover.hh"
+#include "ode/box.hh"
+#include <chrono>
+#include <string>
+
+
+typedef struct bench_config_t
+{
+	std::string name;
+	ode::stepper_t stepper;
+	int iterations;
+	double sor;
+} bench_config_t;
+
+
+// Return the number of steps per second and fill the trajectory of the rover:
+double run( const bench_config_t& config, double duration, double orientation, std::vector<Eigen::Vector3d>& trajectory )
+{
+	const double timestep( 0.001 );
+	const int n_steps( duration/timestep );
+
+
+	// [ Dynamic environment ]
+
+	ode::Environment env( 0.5 );
+	env.set_stepper( config.stepper, config.iterations, config.sor );
+
+
+	// [ Robot ]
+
+	robot::Rover_1 robot( env, Eigen::Vector3d( 0, 0, 0 ) );
+	robot.DeactivateIC();
+	robot.SetCrawlingMode( true );
+	robot.set_own_space( env );
+
+
+	// [ Terrain ]
+
+	float step_height( 0.105*2 );
+	ode::Box step( env, Eigen::Vector3d( 1, 0, step_height/2 ), 1, 1, 3, step_height, false );
+	step.set_rotation( 0, 0, orientation*M_PI/180 );
+	step.make_static();
+	step.set_collision_group( "ground" );
+
+	ode::Box step_c( env, Eigen::Vector3d( 2, 0, step_height/2 ), 1, 2, 3, step_height, false );
+	step_c.make_static();
+	step_c.set_collision_group( "ground" );
+
+
+	// [ Simulation loop ]
+
+	// Cruise speed of the robot:
+	float speedf( 0.04 );
+	// Time to reach cruise speed:
+	float term( 0.5 );
+
+	trajectory.resize( n_steps );
+
+	float speed = 0;
+	auto start = std::chrono::steady_clock::now();
+	for ( int i = 0 ; i < n_steps ; i++ )
+	{
+		if ( speed <= speedf )
+		{
+			speed += speedf/term*timestep;
+			robot.SetRobotSpeed( speed );
+		}
+
+		env.next_step( timestep );
+		robot.next_step( timestep );
+
+		trajectory[i] = robot.GetPosition();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	return n_steps/elapsed.count();
+}
+
+
+int main( int argc, char* argv[] )
+{
+	double duration( 20 );
+	if ( argc > 1 )
+		duration = atof( argv[1] );
+	double orientation( 0 );
+	if ( argc > 2 )
+		orientation = atof( argv[2] );
+
+	dInitODE();
+
+	std::vector<bench_config_t> configs;
+	configs.push_back( { "dWorldStep", ode::WORLD_STEP, 0, 0 } );
+	for ( int iterations : { 10, 20, 50, 100 } )
+		for ( double sor : { 1.0, 1.3 } )
+		{
+			char name[32];
+			snprintf( name, sizeof( name ), "QuickStep %3d it, w=%.1f", iterations, sor );
+			configs.push_back( { name, ode::QUICK_STEP, iterations, sor } );
+		}
+
+	printf( "%.1f s simulated, step orientation: %.1f°\n", duration, orientation );
+	printf( "%-26s %10s %14s %14s %10s\n", "solver", "steps/s", "max dev (m)", "final dev (m)", "final x" );
+
+	std::vector<Eigen::Vector3d> reference;
+	std::vector<Eigen::Vector3d> trajectory;
+	for ( const bench_config_t& config : configs )
+	{
+		double rate = run( config, duration, orientation, ( config.stepper == ode::WORLD_STEP ? reference : trajectory ) );
+		const std::vector<Eigen::Vector3d>& result = ( config.stepper == ode::WORLD_STEP ? reference : trajectory );
+
+		double max_deviation( 0 );
+		for ( int i = 0 ; i < result.size() ; i++ )
+			max_deviation = std::max( max_deviation, ( result[i] - reference[i] ).norm() );
+
+		printf( "%-26s %10.0f %14.4f %14.4f %10.3f\n", config.name.c_str(), rate, max_deviation, ( result.back() - reference.back() ).norm(), result.back().x() );
+	}
+
+	dCloseODE();
+
+	return 0;
+}
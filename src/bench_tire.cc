@@ -0,0 +1,160 @@
+/*
+** Benchmark and behaviour comparison of the tire models of ode::Wheel.
+**
+** The rover climbs the step of rover_training_1 in crawling mode with each tire model.
+** The simulation rate and the number of geoms are reported together with indicators of
+** the climbing behaviour: the times at which the rover passes the edge and the top of
+** the step, its maximal pitch and its deviation from the trajectory of the sphere tires.
+** The sphere tires are also run with a contact window (Rover_1::SetTireContactWindow),
+** for which the average number of contacts per step is compared as well.
+**
+** First argument (optional):
+** Simulated duration in seconds (default: 40).
+**
+** Second argument (optional):
+** Orientation of the step in degrees (default: 0).
+**
+** Third argument (optional):
+** Half-angle of the contact window in degrees (default: 100).
+*/
+
+#include "ode/environment.hh"
+#include "rover.hh"
+#include "ode/box.hh"
+#include <chrono>
+#include <string>
+
+
+typedef struct bench_result_t
+{
+	double rate;
+	int n_geoms;
+	double t_edge;
+	double t_top;
+	double max_pitch;
+	double contacts;
+	std::vector<Eigen::Vector3d> trajectory;
+} bench_result_t;
+
+
+void run( ode::tire_model_t tire_model, double window, double duration, double orientation, bench_result_t& result )
+{
+	const double timestep( 0.001 );
+	const int n_steps( duration/timestep );
+
+
+	// [ Dynamic environment ]
+
+	ode::Environment env( 0.5 );
+
+
+	// [ Robot ]
+
+	robot::Rover_1 robot( env, Eigen::Vector3d( 0, 0, 0 ), tire_model );
+	robot.DeactivateIC();
+	robot.SetCrawlingMode( true );
+	robot.set_own_space( env );
+	if ( window > 0 )
+		robot.SetTireContactWindow( window );
+
+	result.n_geoms = 0;
+	for ( ode::Object::ptr_t body : robot.bodies() )
+		result.n_geoms += body->get_geoms().size();
+
+
+	// [ Terrain ]
+
+	float step_height( 0.105*2 );
+	ode::Box step( env, Eigen::Vector3d( 1, 0, step_height/2 ), 1, 1, 3, step_height, false );
+	step.set_rotation( 0, 0, orientation*M_PI/180 );
+	step.make_static();
+	step.set_collision_group( "ground" );
+
+	ode::Box step_c( env, Eigen::Vector3d( 2, 0, step_height/2 ), 1, 2, 3, step_height, false );
+	step_c.make_static();
+	step_c.set_collision_group( "ground" );
+
+
+	// [ Simulation loop ]
+
+	// Cruise speed of the robot:
+	float speedf( 0.04 );
+	// Time to reach cruise speed:
+	float term( 0.5 );
+
+	result.t_edge = -1;
+	result.t_top = -1;
+	result.max_pitch = 0;
+	result.contacts = 0;
+	result.trajectory.resize( n_steps );
+
+	float speed = 0;
+	auto start = std::chrono::steady_clock::now();
+	for ( int i = 0 ; i < n_steps ; i++ )
+	{
+		if ( speed <= speedf )
+		{
+			speed += speedf/term*timestep;
+			robot.SetRobotSpeed( speed );
+		}
+
+		env.next_step( timestep );
+		robot.next_step( timestep );
+
+		result.contacts += env.get_contact_count();
+
+		Eigen::Vector3d pos = robot.GetPosition();
+		result.trajectory[i] = pos;
+		result.max_pitch = std::max( result.max_pitch, fabs( robot.GetPitchAngle() ) );
+		// The front wheels reach the edge of the step, then the rear wheels climb it:
+		if ( result.t_edge < 0 && pos.x() >= 0.5 - 0.29 - 0.105 )
+			result.t_edge = ( i + 1 )*timestep;
+		if ( result.t_top < 0 && pos.x() >= 0.5 + 0.29 + 0.105 )
+			result.t_top = ( i + 1 )*timestep;
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	result.rate = n_steps/elapsed.count();
+	result.contacts /= n_steps;
+}
+
+
+int main( int argc, char* argv[] )
+{
+	double duration( 40 );
+	if ( argc > 1 )
+		duration = atof( argv[1] );
+	double orientation( 0 );
+	if ( argc > 2 )
+		orientation = atof( argv[2] );
+	double window( 100 );
+	if ( argc > 3 )
+		window = atof( argv[3] );
+
+	dInitODE();
+
+	std::vector<std::string> names = { "spheres", "windowed", "cylinder" };
+	std::vector<bench_result_t> results( 3 );
+	run( ode::SPHERES_TIRE, 0, duration, orientation, results[0] );
+	run( ode::SPHERES_TIRE, window, duration, orientation, results[1] );
+	run( ode::CYLINDER_TIRE, 0, duration, orientation, results[2] );
+
+	printf( "%.1f s simulated, step orientation: %.1f°, contact window: ±%.0f°\n", duration, orientation, window );
+	printf( "%-10s %8s %10s %10s %10s %10s %12s %10s %14s\n", "tire", "geoms", "steps/s", "contacts", "edge (s)", "top (s)", "max pitch", "final x", "max dev (m)" );
+	for ( int i = 0 ; i < results.size() ; i++ )
+	{
+		const bench_result_t& result = results[i];
+
+		// Deviation from the trajectory of the sphere tires:
+		double max_deviation( 0 );
+		for ( int j = 0 ; j < result.trajectory.size() ; j++ )
+			max_deviation = std::max( max_deviation, ( result.trajectory[j] - results[0].trajectory[j] ).norm() );
+
+		printf( "%-10s %8d %10.0f %10.2f %10.3f %10.3f %12.2f %10.3f %14.4f\n", names[i].c_str(), result.n_geoms, result.rate, result.contacts,
+		        result.t_edge, result.t_top, result.max_pitch, result.trajectory.back().x(), max_deviation );
+	}
+
+	dCloseODE();
+
+	return 0;
+}
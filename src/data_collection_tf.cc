@@ -73,11 +73,11 @@ int main( int argc, char* argv[] )
 	float step_height( 0.105*2 );
 	ode::Box step( env, Eigen::Vector3d( 1.5, 0, step_height/2 ), 1, 1, 3, step_height, false );
 	step.set_rotation( 0, 0, orientation*M_PI/180 );
-	step.fix();
+	step.make_static();
 	step.set_collision_group( "ground" );
 
 	ode::Box step_c( env, Eigen::Vector3d( 2.5, 0, step_height/2 ), 1, 2, 3, step_height, false );
-	step_c.fix();
+	step_c.make_static();
 	step_c.set_collision_group( "ground" );
 
 
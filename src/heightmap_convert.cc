@@ -0,0 +1,65 @@
+/*
+** Conversion of a greyscale image to the binary heightmap format of ode::Heightmap.
+**
+** The converted file is memory-mapped by ode::HeightField instead of decoding the image
+** at each construction. The file produced with the default output path is the cache
+** looked up by the image constructor of ode::HeightField.
+**
+** First argument:
+** Path to the image.
+**
+** Second argument:
+** Height of the white pixels in metres.
+**
+** Third argument (optional):
+** Storage of the samples: int16 or float (default: int16).
+**
+** Fourth argument (optional):
+** Path to the output file (default: path to the image + .hmap).
+*/
+
+#include "ode/heightmap.hh"
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+
+int main( int argc, char* argv[] )
+{
+	if ( argc < 3 )
+	{
+		fprintf( stderr, "Usage: %s <image> <z_scale> [int16|float] [output]\n", argv[0] );
+		return 1;
+	}
+
+	std::string image_path( argv[1] );
+	double z_scale = atof( argv[2] );
+	ode::sample_type_t sample_type( ode::INT16_SAMPLES );
+	if ( argc > 3 )
+	{
+		if ( strcmp( argv[3], "float" ) == 0 )
+			sample_type = ode::FLOAT_SAMPLES;
+		else if ( strcmp( argv[3], "int16" ) != 0 )
+		{
+			fprintf( stderr, "Unknown sample type: %s\n", argv[3] );
+			return 1;
+		}
+	}
+	std::string output_path( argc > 4 ? argv[4] : image_path + HEIGHTMAP_EXTENSION );
+
+	try
+	{
+		ode::Heightmap::convert_image( image_path, z_scale, sample_type, output_path );
+		ode::Heightmap::ptr_t heightmap = ode::Heightmap::load( output_path );
+		printf( "%s: %dx%d %s samples, z_scale %g m\n", output_path.c_str(), heightmap->get_rows(), heightmap->get_cols(),
+		        ( sample_type == ode::FLOAT_SAMPLES ? "float" : "int16" ), z_scale );
+	}
+	catch ( const std::exception& e )
+	{
+		fprintf( stderr, "%s\n", e.what() );
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,270 @@
+/*
+** Scene with a large field of static obstacles and benchmark of the collision detection against it.
+**
+** Boxes, spheres and cylinders are scattered over a square area centred on a Rover_1, except
+** on a clear patch around its starting position. In bench mode, the rover drives for a fixed
+** number of steps for each broadphase space and increasing numbers of obstacles, and the time
+** spent per step in dSpaceCollide, dCollide and the stepping of the world is printed as CSV.
+**
+** First argument (optional):
+** "display" to show the scene (default), "nodisplay" to run it without display or "bench" to
+** run the benchmark.
+**
+** Second argument (optional):
+** Number of obstacles (default: 1000), or largest number of obstacles of the benchmark (default: 10000).
+**
+** Third argument (optional):
+** Side of the square area covered by the obstacles in m (default: 50).
+**
+** Fourth argument (optional):
+** Number of simulation steps per configuration of the benchmark (default: 500).
+*/
+
+#include "ode/environment.hh"
+#include "renderer/osg_visitor.hh"
+#include "rover.hh"
+#include "ode/terrain_pool.hh"
+#include "renderer/sim_loop.hh"
+#include "renderer/osg_text.hh"
+#include <random>
+
+
+// Radius of the clear patch around the starting position of the rover:
+#define CLEAR_RADIUS 1.0
+
+
+void scatter_obstacles( ode::Terrain_pool& pool, int n_obstacles, double area )
+{
+	std::mt19937 gen( 0 );
+	std::uniform_real_distribution<double> uniform( 0, 1 );
+
+	pool.begin();
+	for ( int i = 0 ; i < n_obstacles ; i++ )
+	{
+		Eigen::Vector3d pos;
+		do
+		{
+			pos = Eigen::Vector3d( area*( uniform( gen ) - 0.5 ), area*( uniform( gen ) - 0.5 ), 0 );
+		}
+		while ( pos.norm() < CLEAR_RADIUS );
+		Eigen::Quaterniond q( Eigen::AngleAxisd( 2*M_PI*uniform( gen ), Eigen::Vector3d::UnitZ() ) );
+
+		double size = 0.05 + 0.25*uniform( gen );
+		switch ( i % 3 )
+		{
+			case 0 :
+				pos.z() = size/2;
+				pool.add_box( pos, size, 0.05 + 0.25*uniform( gen ), size, q );
+				break;
+			case 1 :
+				// Half-buried rock:
+				pool.add_sphere( pos, size );
+				break;
+			case 2 :
+				pos.z() = size/2;
+				pool.add_cylinder( pos, 0.5*( 0.05 + 0.25*uniform( gen ) ), size, q );
+				break;
+		}
+	}
+	pool.end();
+}
+
+
+typedef struct bench_config_t
+{
+	const char* name;
+	ode::space_config_t space;
+	int max_obstacles;
+} bench_config_t;
+
+
+void bench( const bench_config_t& config, int n_obstacles, double area, int n_steps )
+{
+	const double timestep( 0.001 );
+
+	ode::Environment env( config.space, true, 0.5 );
+
+	robot::Rover_1 robot( env, Eigen::Vector3d( 0, 0, 0 ) );
+	robot.DeactivateIC();
+	robot.SetCrawlingMode( true );
+	robot.set_own_space( env );
+
+	ode::Terrain_pool obstacles( env, "ground" );
+	scatter_obstacles( obstacles, n_obstacles, area );
+
+	// Let the rover settle on the ground before measuring:
+	for ( int i = 0 ; i < 100 ; i++ )
+	{
+		env.next_step( timestep );
+		robot.next_step( timestep );
+	}
+
+	env.set_profiling( true );
+	robot.SetRobotSpeed( 0.04 );
+
+	auto start = std::chrono::steady_clock::now();
+	for ( int i = 0 ; i < n_steps ; i++ )
+	{
+		env.next_step( timestep );
+		robot.next_step( timestep );
+	}
+	std::chrono::duration<double> total_time = std::chrono::steady_clock::now() - start;
+
+	const ode::collision_profile_t& profile = env.get_profile();
+	printf( "%s,%d,%lu,%.3f,%.3f,%.3f,%.1f,%.1f,%.0f\n", config.name, n_obstacles, profile.steps,
+	        1e6*profile.space_collide_time/profile.steps, 1e6*profile.narrowphase_time/profile.steps, 1e6*profile.step_time/profile.steps,
+	        double( profile.pairs )/profile.steps, double( profile.contacts )/profile.steps, profile.steps/total_time.count() );
+	fflush( stdout );
+}
+
+
+int main( int argc, char* argv[] )
+{
+	bool bench_mode( argc > 1 && strncmp( argv[1], "bench", 6 ) == 0 );
+	int n_obstacles( bench_mode ? 10000 : 1000 );
+	if ( argc > 2 )
+		n_obstacles = atoi( argv[2] );
+	double area( 50 );
+	if ( argc > 3 )
+		area = atof( argv[3] );
+	int n_steps( 500 );
+	if ( argc > 4 )
+		n_steps = atoi( argv[4] );
+
+	dInitODE();
+
+
+	// [ Benchmark ]
+
+	if ( bench_mode )
+	{
+		std::vector<bench_config_t> configs;
+
+		configs.push_back( { "hash", ode::space_config_t( ode::HASH_SPACE ), n_obstacles } );
+
+		// Cells from 3 cm (tire spheres) to 4 m (rover):
+		ode::space_config_t tuned_hash( ode::HASH_SPACE );
+		tuned_hash.hash_min_level = -5;
+		tuned_hash.hash_max_level = 2;
+		configs.push_back( { "hash (-5 2)", tuned_hash, n_obstacles } );
+
+		configs.push_back( { "SAP", ode::space_config_t( ode::SAP_SPACE ), n_obstacles } );
+
+		ode::space_config_t quadtree( ode::QUADTREE_SPACE );
+		quadtree.center = Eigen::Vector3d( 0, 0, 0 );
+		quadtree.extents = Eigen::Vector3d( area/2 + 1, area/2 + 1, 2 );
+		quadtree.depth = 7;
+		configs.push_back( { "quadtree", quadtree, n_obstacles } );
+
+		// Quadratic in the number of geoms:
+		configs.push_back( { "simple", ode::space_config_t( ode::SIMPLE_SPACE ), std::min( n_obstacles, 1000 ) } );
+
+		const int counts[] = { 100, 300, 1000, 3000, 10000, 30000, 100000 };
+
+		printf( "space,obstacles,steps,space_collide_us,narrowphase_us,step_us,pairs_per_step,contacts_per_step,steps_per_s\n" );
+		for ( const bench_config_t& config : configs )
+			for ( int count : counts )
+				if ( count <= config.max_obstacles )
+					bench( config, count, area, n_steps );
+
+		dCloseODE();
+
+		return 0;
+	}
+
+
+	// [ Dynamic environment ]
+
+	ode::Environment env( 0.5 );
+
+
+	// [ Robot ]
+
+	robot::Rover_1 robot( env, Eigen::Vector3d( 0, 0, 0 ) );
+	robot.DeactivateIC();
+	robot.SetCrawlingMode( true );
+	robot.set_own_space( env );
+
+
+	// [ Terrain ]
+
+	ode::Terrain_pool obstacles( env, "ground" );
+	scatter_obstacles( obstacles, n_obstacles, area );
+
+
+	// [ Simulation rules ]
+
+	// Cruise speed of the robot:
+	float speedf( 0.04 );
+	// Time to reach cruise speed:
+	float term( 0.5 );
+
+	float speed = 0;
+
+	env.set_profiling( true );
+
+	std::function<bool(float,double)> step_function = [&]( float timestep, double time )
+	{
+		if ( fabs( speed ) <= fabs( speedf ) )
+		{
+			speed += speedf/term*timestep;
+			robot.SetRobotSpeed( speed );
+		}
+
+		env.next_step( timestep );
+		robot.next_step( timestep );
+
+		return false;
+	};
+
+
+	// [ Display ]
+
+	renderer::OsgVisitor* display_ptr;
+
+	if ( argc > 1 && strncmp( argv[1], "nodisplay", 10 ) == 0 )
+		display_ptr = nullptr;
+	else
+	{
+		int x( 200 ), y( 200 ), width( 1024 ), height( 768 );
+		display_ptr = new renderer::OsgVisitor( 0, width, height, x, y, 20, 20, osg::Vec3( -0.7, -2, 0.6 ), osg::Vec3( 0, 0, -0.1 ) );
+
+		display_ptr->set_window_name( "Obstacle field" );
+		display_ptr->get_keh()->set_pause();
+
+		robot.accept( *display_ptr );
+		obstacles.accept( *display_ptr );
+
+		robot::RoverControl* keycontrol = new robot::RoverControl( &robot, display_ptr->get_viewer() );
+
+
+		std::function<bool(renderer::OsgText*)> update_text = [&]( renderer::OsgText* text )
+		{
+			const ode::collision_profile_t& profile = env.get_profile();
+			unsigned long steps = std::max( profile.steps, 1ul );
+			char buff[200];
+			snprintf( buff, sizeof( buff ), "Obstacles: %d\ndSpaceCollide: %6.1f us\ndCollide: %6.1f us\nStep: %6.1f us\nx: %5.2f m\ny: %5.2f m",
+			          obstacles.get_active_count(), 1e6*profile.space_collide_time/steps, 1e6*profile.narrowphase_time/steps,
+			          1e6*profile.step_time/steps, robot.GetPosition().x(), robot.GetPosition().y() );
+			text->set_text( buff );
+
+			return false;
+		};
+
+		renderer::OsgText::ptr_t text = display_ptr->add_text( "hud" );
+		text->set_pos( 3 );
+		text->set_size( 3.5 );
+		text->add_background();
+		text->set_callback( update_text );
+	}
+
+
+	// [ Simulation loop ]
+
+	Sim_loop sim( 0.001, display_ptr, false, 1 );
+
+	sim.loop( step_function );
+
+
+	return 0;
+}
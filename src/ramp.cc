@@ -51,9 +51,9 @@ int main( int argc, char* argv[] )
 	ode::Box ramp_part3( env, Eigen::Vector3d( x - x2, y, 0 ), 1, l2, w, h2, false );
 	ramp_part3.set_rotation( 0, slope*M_PI/180, 0 );
 
-	ramp_part1.fix();
-	ramp_part2.fix();
-	ramp_part3.fix();
+	ramp_part1.make_static();
+	ramp_part2.make_static();
+	ramp_part3.make_static();
 	ramp_part1.set_collision_group( "ground" );
 	ramp_part2.set_collision_group( "ground" );
 	ramp_part3.set_collision_group( "ground" );
@@ -2,8 +2,9 @@
 #define ROVER_HH 
 
 #include "ode/robot.hh"
-#include "Filters/cpp/filters.hh" // https://github.com/Bouty92/Filters
+#include "ode/filter_bank.hh"
 #include "ode/ft_sensor.hh"
+#include "ode/wheel.hh"
 
 #include <osgViewer/Viewer>
 
@@ -19,7 +20,45 @@ class Rover_1 : public Robot
 {
 	public:
 
-	Rover_1( ode::Environment& env, const Eigen::Vector3d& pose );
+	// Pose and tilt of the main body, computed once per step (angles in degrees, rates in rad/s):
+	typedef struct kinematics_t
+	{
+		Eigen::Vector3d position; // Centre of the rover at the height of the boggie joint
+		Eigen::Matrix3d rotation;
+		double direction;
+		double roll;
+		double pitch;
+		double roll_rate;
+		double pitch_rate;
+		bool upside_down;
+	} kinematics_t;
+
+	typedef struct rover_state_t : public Robot::state_t
+	{
+		double robot_speed;
+		double steering_rate;
+		double boggie_torque;
+		double W[NBWHEELS];
+		dReal wheel_vel[NBWHEELS];
+		dReal wheel_fmax[NBWHEELS];
+		double torque_output[NBWHEELS];
+		FT_sensor_group ft_sensors;
+		double torque_sum[NBWHEELS];
+		int n_torque_samples;
+		bool torque_feedback;
+		ode::Filter_bank<12> ft_filters;
+		double sensor_period;
+		double sensor_clock;
+		double ft_sum_time;
+		ode::Filter_bank<12>::array_t ft_sum;
+		bool ic_activated;
+		double ic_period;
+		double ic_clock;
+		bool ic_tick;
+		bool crawling_mode;
+	} rover_state_t;
+
+	Rover_1( ode::Environment& env, const Eigen::Vector3d& pose, ode::tire_model_t tire_model = ode::SPHERES_TIRE );
 
 	void SetRobotSpeed( double speed );
 	inline double GetRobotSpeed() const { return _robot_speed; }
@@ -34,6 +73,15 @@ class Rover_1 : public Robot
 	inline void SetCrawlingMode( bool crawl ) { _crawling_mode = crawl; }
 	inline bool IsCrawlingMode() const { return _crawling_mode; }
 
+	/// Only the tire spheres within half_angle (in degrees) of the downward direction can collide
+	/// (0 to enable all of them). Climbing a step requires a window wide enough to reach its edge.
+	void SetTireContactWindow( double half_angle );
+
+	/// Replace the collision boxes and motor cylinders of the chassis and forks by triangle meshes built
+	/// from their rendering meshes (see ode::Trimesh_data). The masses are unchanged.
+	void UseMeshCollisions();
+	inline bool IsUsingMeshCollisions() const { return _mesh_collisions; }
+
 	void SetBoggieTorque( double torque );
 	inline double GetBoggieTorque() const { return _boggie_torque; }
 
@@ -43,26 +91,56 @@ class Rover_1 : public Robot
 	inline void SetCmdPeriod( double period ) { _ic_period = period; }
 	inline double GetCmdPeriod() const { return _ic_period; }
 
-	inline void ActivateIC() { _ic_activated = true; }
+	/// Rate (in Hz) at which the filtered force-torque observations are updated, 0 (the default) updating them
+	/// at every step. The springs of the sensors still act at every step: in between two updates, their forces
+	/// and torques are averaged over time, which prevents aliasing, and the low-pass filters are designed for this
+	/// rate. The rate must be more than twice the cutoff frequency of the filters (2 Hz). The updates are aligned
+	/// on the ticks of the internal control, a shorter period being flushed at each tick, so that the observations
+	/// are up to date: the command period should be a multiple of the sensor period to keep them regular.
+	void SetSensorRate( double rate );
+	inline double GetSensorRate() const { return _sensor_period > 0 ? 1./_sensor_period : 0; }
+
+	/// With the wheel torque sensing, the first tick after an activation is delayed until its window has been measured.
+	void ActivateIC();
 	inline void DeactivateIC() { _ic_activated = false; }
 	inline bool IsICActivated() const { return _ic_activated; }
 	inline bool ICTick() const { return _ic_tick; }
-
-	Eigen::Vector3d GetPosition() const;
-	double GetDirection() const;
-	bool IsUpsideDown() const;
-	double GetRollAngle() const;
-	double GetPitchAngle() const;
-	void GetTiltRates( double& roll_rate, double& pitch_rate ) const;
+	/// Simulated time left before the next call of the internal control (infinite if it is deactivated):
+	inline double GetTimeToNextTick() const { return _ic_activated ? std::max( 0., _ic_period - _ic_clock ) : dInfinity; }
+
+	/// The kinematic getters read a record updated at the beginning of next_step and by restore_state, which
+	/// is therefore up to date between the step of the environment and the next one. Call UpdateKinematics
+	/// after moving the bodies by any other means.
+	void UpdateKinematics();
+	inline const kinematics_t& GetKinematics() const { return _kinematics; }
+	inline Eigen::Vector3d GetPosition() const { return _kinematics.position; }
+	inline double GetDirection() const { return _kinematics.direction; }
+	inline bool IsUpsideDown() const { return _kinematics.upside_down; }
+	inline double GetRollAngle() const { return _kinematics.roll; }
+	inline double GetPitchAngle() const { return _kinematics.pitch; }
+	inline void GetTiltRates( double& roll_rate, double& pitch_rate ) const { roll_rate = _kinematics.roll_rate; pitch_rate = _kinematics.pitch_rate; }
 	double GetBoggieAngle() const;
+	bool IsBoggieAtLimit() const;
+	/// Largest relative velocity across the springs of the force-torque sensors:
+	double GetFtExtensionRate() const;
 	Eigen::Matrix<double,4,3> GetFT300Torsors() const;
+	/// Torques of the wheel motors averaged over the last window of SetWheelTorqueSensing:
 	inline const double* GetWheelTorques() const { return _torque_output; }
 
+	/// Measure the torques of the wheel motors over the last window seconds before each tick of the internal
+	/// control. The feedback of the wheel joints, which costs a copy of their forces at each step in ODE, is
+	/// only attached during this window. Disabled by default.
+	virtual void SetWheelTorqueSensing( bool enable, double window = 0.05 );
+	inline bool IsWheelTorqueSensing() const { return _torque_sensing; }
+
 	void PrintFT300Torsors( bool endl = true ) const;
 	void PrintWheelTorques( bool endl = true ) const;
 
 	virtual void next_step( double dt = ode::Environment::time_step );
 
+	virtual state_ptr_t save_state() const;
+	virtual void restore_state( const state_t& state );
+
 	virtual ~Rover_1();
 
 	double steering_max_vel;
@@ -77,8 +155,12 @@ class Rover_1 : public Robot
 	void _ApplySteeringControl();
 	void _ApplyBoggieControl();
 
-	void _UpdateTorqueFilters();
-	void _UpdateFtFilters();
+	void _SetWheelFeedback( bool attached );
+	void _AccumulateWheelTorques();
+	void _UpdateWheelTorques();
+	void _UpdateFtFilters( double dt );
+	void _SyncFtFilters();
+	void _ResetSensorFilters();
 	
 	double _robot_speed;
 	double _steering_rate;
@@ -130,6 +212,7 @@ class Rover_1 : public Robot
 	double fork_height;
 	double fork_width;
 
+	ode::Object::ptr_t _rear_body;
 	ode::Object::ptr_t _front_fork;
 	ode::Object::ptr_t _rear_fork;
 	ode::Object::ptr_t _wheel[NBWHEELS];
@@ -138,12 +221,22 @@ class Rover_1 : public Robot
 	dJointID _wheel_joint[NBWHEELS];
 
 	dJointFeedback _wheel_feedback[NBWHEELS];
-	filters::ptr_t<double> _torque_filter[NBWHEELS];
+	bool _torque_sensing;
+	double _torque_window;
+	bool _torque_feedback;
+	double _torque_sum[NBWHEELS];
+	int _n_torque_samples;
 	double _torque_output[NBWHEELS];
 
-	FT_sensor _front_ft_sensor;
-	FT_sensor _rear_ft_sensor;
-	filters::ptr_t<double> _ft_filter[12];
+	// Front sensor, then rear one:
+	FT_sensor_group _ft_sensors;
+	// Forces and torques of the front sensor, then of the rear one:
+	ode::Filter_bank<12> _ft_filter;
+	double _sensor_period;
+	double _sensor_clock;
+	// Integral of the torsors since the last update of the filters, and time it covers:
+	double _ft_sum_time;
+	ode::Filter_bank<12>::array_t _ft_sum;
 
 	double _W[NBWHEELS];
 
@@ -153,6 +246,9 @@ class Rover_1 : public Robot
 	bool _ic_tick;
 
 	bool _crawling_mode;
+	double _tire_window;
+	kinematics_t _kinematics;
+	bool _mesh_collisions;
 };
 
 
@@ -6,6 +6,12 @@
 #define RAD_TO_DEG 57.29577951308232
 #define DEG_TO_RAD 0.017453292519943295
 
+// Natural frequency (rad/s) and damping ratio of the low-pass filters of the force-torque sensors:
+#define FT_FILTER_FREQ ( 4*M_PI )
+#define SENSOR_FILTER_DAMPING 0.5
+// Period of the filters updated at every step:
+#define SENSOR_FILTER_PERIOD 0.001
+
 
 using namespace ode;
 using namespace Eigen;
@@ -15,14 +21,21 @@ namespace robot
 {
 
 
-Rover_1::Rover_1( Environment& env, const Vector3d& pose ) :
+Rover_1::Rover_1( Environment& env, const Vector3d& pose, tire_model_t tire_model ) :
 				  _robot_speed( 0 ),
 				  _steering_rate( 0 ),
 				  _boggie_torque( 0 ),
                   _ic_period( 0 ),
                   _ic_clock( 0 ),
                   _ic_activated( true ),
-				  _crawling_mode( false )
+				  _crawling_mode( false ),
+				  _tire_window( 0 ),
+				  _sensor_period( 0 ),
+				  _torque_sensing( false ),
+				  _torque_window( 0 ),
+				  _torque_feedback( false ),
+				  _n_torque_samples( 0 ),
+				  _mesh_collisions( false )
 {
 	// [ Rover's parameters ]
 
@@ -132,12 +145,12 @@ Rover_1::Rover_1( Environment& env, const Vector3d& pose ) :
 	dJointSetSliderParam( battery_clamp, dParamHiStop, 0 );
 
 
-	ode::Object::ptr_t rear_body( new Box( env,
-						                   pose + rear_pos,
-						                   rear_mass,
-						                   rear_length, rear_width, rear_height ) );
-	rear_body->set_mesh( "../meshes/rear.obj" );
-	_bodies.push_back( rear_body );
+	_rear_body = Object::ptr_t( new Box( env,
+						                 pose + rear_pos,
+						                 rear_mass,
+						                 rear_length, rear_width, rear_height ) );
+	_rear_body->set_mesh( "../meshes/rear.obj" );
+	_bodies.push_back( _rear_body );
 
 
 	ode::Object::ptr_t boggie( new Box( env,
@@ -179,7 +192,7 @@ Rover_1::Rover_1( Environment& env, const Vector3d& pose ) :
 	// [ Centre hinge joint ]
 
 	Servo::ptr_t centre_hinge_servo( new Servo( env,
-					                            *rear_body, *_main_body,
+					                            *_rear_body, *_main_body,
 					                            pose + hinge_pos,
 					                            Vector3d( 0, 0, 1 ),
 					                            STEERING_SERVOS_K,
@@ -192,7 +205,7 @@ Rover_1::Rover_1( Environment& env, const Vector3d& pose ) :
 	// [ Boggie joint ]
 
 	_boggie_hinge = dJointCreateHinge( env.get_world(), 0 );
-	dJointAttach( _boggie_hinge, boggie->get_body(), rear_body->get_body() );
+	dJointAttach( _boggie_hinge, boggie->get_body(), _rear_body->get_body() );
 	dJointSetHingeAxis( _boggie_hinge, 1, 0, 0 );
 	Vector3d sea_joint_pos = pose + sea_pos;
 	dJointSetHingeAnchor( _boggie_hinge, sea_joint_pos.x(), sea_joint_pos.y(), sea_joint_pos.z() );
@@ -202,18 +215,19 @@ Rover_1::Rover_1( Environment& env, const Vector3d& pose ) :
 
 	// [ Force-torque sensors ]
 
-	_front_ft_sensor = FT_sensor( _main_body.get(), _front_fork.get(), pose + Vector3d( wheelbase/2, 0, belly_elev ), FORK_K_LIN, FORK_K_ANG, FORK_C_LIN, FORK_C_ANG );
-	_rear_ft_sensor = FT_sensor( boggie.get(), _rear_fork.get(), pose + Vector3d( -wheelbase/2, 0, belly_elev ), FORK_K_LIN, FORK_K_ANG, FORK_C_LIN, FORK_C_ANG );
+	_ft_sensors.Add( _main_body.get(), _front_fork.get(), pose + Vector3d( wheelbase/2, 0, belly_elev ), FORK_K_LIN, FORK_K_ANG, FORK_C_LIN, FORK_C_ANG );
+	_ft_sensors.Add( boggie.get(), _rear_fork.get(), pose + Vector3d( -wheelbase/2, 0, belly_elev ), FORK_K_LIN, FORK_K_ANG, FORK_C_LIN, FORK_C_ANG );
 
 
 	for ( int i = 0 ; i < NBWHEELS ; i++ )
 	{
 		// [ Definition of wheels ]
 
-		_wheel[i] = Object::ptr_t( new ode::Wheel( env, pose + wheel_position[i], wheel_mass, wheel_radius[i], wheel_width, wheel_def ) );
+		_wheel[i] = Object::ptr_t( new ode::Wheel( env, pose + wheel_position[i], wheel_mass, wheel_radius[i], wheel_width, wheel_def, true, tire_model ) );
 		_wheel[i]->set_rotation( M_PI/2, 0, 0 );
 		_bodies.push_back( _wheel[i] );
 		_wheel[i]->set_contact_type( SOFT );
+		_wheel[i]->set_all_material( "tire" );
 		_wheel[i]->set_color( 0.2, 0.2, 0.2 );
 		
 
@@ -229,79 +243,98 @@ Rover_1::Rover_1( Environment& env, const Vector3d& pose ) :
 		dJointSetHingeParam( _wheel_joint[i], dParamFMax, WHEELS_MAX_TORQUE );
 		//dJointSetHingeParam( _wheel_joint[i], dParamFMax, 0 );
 
-		//dJointSetFeedback( _wheel_joint[i], &_wheel_feedback[i] );
+		_torque_sum[i] = 0;
+		_torque_output[i] = 0;
 	}
 
 
 	// [ Initialisation of filters ]
 	
-	for ( int i = 0 ; i < NBWHEELS ; i++ )
-		_torque_filter[i] = filters::ptr_t<double>( new filters::LP_second_order_bilinear<double>( 0.001, 2*M_PI, 0.5, nullptr, _torque_output + i ) );
+	_ResetSensorFilters();
 
-	const Vector3d* vec[] = { _front_ft_sensor.GetForces(), _front_ft_sensor.GetTorques(), _rear_ft_sensor.GetForces(), _rear_ft_sensor.GetTorques() };
-	for ( int i = 0 ; i < 4 ; i++ )
-		for ( int j = 0 ; j < 3 ; j++ )
-			_ft_filter[i*3+j] = filters::ptr_t<double>( new filters::LP_second_order_bilinear<double>( 0.001, 4*M_PI, 0.5, vec[i]->data() + j, (double*) vec[i]->data() + j ) );
+	UpdateKinematics();
 }
 
 
-Vector3d Rover_1::GetPosition() const
+void Rover_1::UpdateKinematics()
 {
-	dVector3 center_pos;
-	dBodyGetRelPointPos( _main_body->get_body(), -front_pos[0], -front_pos[1], -front_pos[2] + sea_elev, center_pos );
-	return Vector3d( center_pos[0], center_pos[1], center_pos[2] );
-}
-
+	dBodyID body = _main_body->get_body();
+	// Rotation matrix of ODE, row by row with a padding element. Its columns are the axes of the body:
+	const dReal* R = dBodyGetRotation( body );
+	_kinematics.rotation << R[0], R[1], R[2],
+	                        R[4], R[5], R[6],
+	                        R[8], R[9], R[10];
 
-double Rover_1::GetDirection() const
-{
+	dVector3 center_pos;
+	dBodyGetRelPointPos( body, -front_pos[0], -front_pos[1], -front_pos[2] + sea_elev, center_pos );
+	_kinematics.position = Vector3d( center_pos[0], center_pos[1], center_pos[2] );
+
+	// x axis:
+	_kinematics.direction = asin( R[4] )*RAD_TO_DEG;
+	if ( R[0] < 0 )
+		_kinematics.direction = ( R[4] > 0 ? 1 : -1 )*180 - _kinematics.direction;
+	_kinematics.pitch = asin( -R[8] )*RAD_TO_DEG;
+	// y axis:
+	_kinematics.roll = asin( R[9] )*RAD_TO_DEG;
+	// z axis:
+	_kinematics.upside_down = ( R[10] < 0 );
+
+	const dReal* angular_vel = dBodyGetAngularVel( body );
 	dVector3 vec;
-	dBodyVectorToWorld( _main_body->get_body(), 1, 0, 0, vec );
-	double direction = asin( vec[1] )*RAD_TO_DEG;
-	if ( vec[0] < 0 )
-		direction = ( vec[1] > 0 ? 1 : -1 )*180 - direction;
-	//direction += GetSteeringTrueAngle()/2;
-	return direction;
+	dBodyVectorFromWorld( body, angular_vel[0], angular_vel[1], angular_vel[2], vec );
+	_kinematics.roll_rate = vec[0];
+	_kinematics.pitch_rate = vec[1];
 }
 
 
-bool Rover_1::IsUpsideDown() const
+double Rover_1::GetBoggieAngle() const
 {
-	dVector3 vec;
-	dBodyVectorToWorld( _main_body->get_body(), 0, 0, 1, vec );
-	return ( vec[2] < 0 ? true : false );
+	return dJointGetHingeAngle( _boggie_hinge )*RAD_TO_DEG;
 }
 
 
-double Rover_1::GetRollAngle() const
+void Rover_1::UseMeshCollisions()
 {
-	dVector3 vec;
-	dBodyVectorToWorld( _main_body->get_body(), 0, 1, 0, vec );
-	return asin( vec[2] )*RAD_TO_DEG;
+	if ( _mesh_collisions )
+		return;
+
+	for ( Object::ptr_t body : { _main_body, _rear_body, _front_fork, _rear_fork } )
+	{
+		const char* group = body->get_collision_group();
+		body->set_all_contact_type( DISABLED );
+		body->add_trimesh_geom( Trimesh_data::load_obj( body->get_mesh_path() ) );
+		// The geom is created in the space of the environment, so it is moved into the one of the robot if it has one:
+		if ( _space )
+		{
+			dGeomID mesh_geom = body->get_geoms().back();
+			dSpaceRemove( dGeomGetSpace( mesh_geom ), mesh_geom );
+			dSpaceAdd( _space, mesh_geom );
+		}
+		if ( group != NULL )
+			body->set_collision_group( group );
+	}
+	_mesh_collisions = true;
 }
 
 
-double Rover_1::GetPitchAngle() const
+void Rover_1::SetTireContactWindow( double half_angle )
 {
-	dVector3 vec;
-	dBodyVectorToWorld( _main_body->get_body(), 1, 0, 0, vec );
-	return asin( -vec[2] )*RAD_TO_DEG;
+	_tire_window = half_angle;
+	for ( int i = 0 ; i < NBWHEELS ; i++ )
+		static_cast<ode::Wheel*>( _wheel[i].get() )->set_contact_window( half_angle*DEG_TO_RAD );
 }
 
 
-void Rover_1::GetTiltRates( double& roll_rate, double& pitch_rate ) const
+bool Rover_1::IsBoggieAtLimit() const
 {
-	const dReal* angular_vel = dBodyGetAngularVel( _main_body->get_body() );
-	dVector3 vec;
-	dBodyVectorFromWorld( _main_body->get_body(), angular_vel[0], angular_vel[1], angular_vel[2], vec );
-	roll_rate = vec[0];
-	pitch_rate = vec[1];
+	// Within one degree of the stops:
+	return fabs( GetBoggieAngle() ) >= boggie_angle_max - 1;
 }
 
 
-double Rover_1::GetBoggieAngle() const
+double Rover_1::GetFtExtensionRate() const
 {
-	return dJointGetHingeAngle( _boggie_hinge )*RAD_TO_DEG;
+	return std::max( _ft_sensors.GetExtensionRate( 0 ), _ft_sensors.GetExtensionRate( 1 ) );
 }
 
 
@@ -416,43 +449,150 @@ void Rover_1::_ApplyBoggieControl()
 }
 
 
-void Rover_1::_UpdateTorqueFilters()
+void Rover_1::SetWheelTorqueSensing( bool enable, double window )
 {
+	if ( enable && window <= 0 )
+		throw std::runtime_error( "The window of the wheel torque sensing must be positive" );
+
+	_torque_sensing = enable;
+	_torque_window = window;
+	_SetWheelFeedback( false );
 	for ( int i = 0 ; i < NBWHEELS ; i++ )
 	{
-		dVector3* t_abs = &_wheel_feedback[i].t1;
-		dVector3 t_rel;
-		dBodyVectorFromWorld( _wheel[i]->get_body(), *t_abs[0], *t_abs[1], *t_abs[2], t_rel );
-		_torque_filter[i]->update( -t_rel[2] );
+		_torque_sum[i] = 0;
+		_torque_output[i] = 0;
 	}
+	_n_torque_samples = 0;
 }
 
 
-void Rover_1::_UpdateFtFilters()
+void Rover_1::ActivateIC()
 {
-	for ( int i = 0 ; i < 12 ; i++ )
-		_ft_filter[i]->update();
+	// The clock has run since the deactivation, so the first tick would otherwise be immediate, with no torque measured:
+	if ( ! _ic_activated && _torque_sensing )
+		_ic_clock = std::min( _ic_clock, _ic_period - _torque_window );
+	_ic_activated = true;
 }
 
 
-Matrix<double,4,3> Rover_1::GetFT300Torsors() const
+void Rover_1::_SetWheelFeedback( bool attached )
+{
+	for ( int i = 0 ; i < NBWHEELS ; i++ )
+		dJointSetFeedback( _wheel_joint[i], attached ? &_wheel_feedback[i] : 0 );
+	_torque_feedback = attached;
+}
+
+
+void Rover_1::_AccumulateWheelTorques()
+{
+	for ( int i = 0 ; i < NBWHEELS ; i++ )
+	{
+		// Torque applied by the joint on the wheel (its body 2) along the axis, which goes through the centre of the wheel:
+		dVector3 axis;
+		dJointGetHingeAxis( _wheel_joint[i], axis );
+		const dReal* t_abs = _wheel_feedback[i].t2;
+		_torque_sum[i] += t_abs[0]*axis[0] + t_abs[1]*axis[1] + t_abs[2]*axis[2];
+	}
+	_n_torque_samples++;
+}
+
+
+void Rover_1::_UpdateWheelTorques()
+{
+	if ( _n_torque_samples > 0 )
+		for ( int i = 0 ; i < NBWHEELS ; i++ )
+			_torque_output[i] = _torque_sum[i]/_n_torque_samples;
+
+	for ( int i = 0 ; i < NBWHEELS ; i++ )
+		_torque_sum[i] = 0;
+	_n_torque_samples = 0;
+	_SetWheelFeedback( false );
+}
+
+
+void Rover_1::SetSensorRate( double rate )
+{
+	if ( rate > 0 && FT_FILTER_FREQ >= M_PI*rate )
+		throw std::runtime_error( "Sensor rate too low for the cutoff frequency of the sensor filters" );
+	_sensor_period = ( rate > 0 ? 1./rate : 0 );
+	_ResetSensorFilters();
+}
+
+
+void Rover_1::_ResetSensorFilters()
+{
+	double dt = ( _sensor_period > 0 ? _sensor_period : SENSOR_FILTER_PERIOD );
+	_ft_filter.set_low_pass( dt, FT_FILTER_FREQ, SENSOR_FILTER_DAMPING );
+	_ft_filter.reset();
+
+	_sensor_clock = 0;
+	_ft_sum_time = 0;
+	_ft_sum.setZero();
+}
+
+
+void Rover_1::_UpdateFtFilters( double dt )
+{
+	// The torsors of the sensors are stored in the order of the channels:
+	Map<const Filter_bank<12>::array_t> torsors( _ft_sensors.GetTorsors().data() );
+
+	if ( _sensor_period <= 0 )
+	{
+		// The filters are designed for SENSOR_FILTER_PERIOD: a longer step (adaptive timestep) advances them
+		// as many times with the torsors held, so that their response doesn't depend on the timestep:
+		int n_updates = std::max( 1, int( lround( dt/SENSOR_FILTER_PERIOD ) ) );
+		for ( int k = 0 ; k < n_updates ; k++ )
+			_ft_filter.update( torsors );
+		return;
+	}
+
+	// Average over the sensor period, weighted by the timesteps:
+	_ft_sum += dt*torsors;
+	_ft_sum_time += dt;
+	_sensor_clock += dt;
+	// The remainder of the clock is kept so that the updates don't drift. A step longer than the period
+	// holds its torsors for the following updates:
+	while ( _sensor_clock >= _sensor_period - 1e-6 )
+	{
+		if ( _ft_sum_time > 0 )
+			_ft_filter.update( _ft_sum/_ft_sum_time );
+		else
+			_ft_filter.update( torsors );
+
+		_sensor_clock -= _sensor_period;
+		_ft_sum_time = 0;
+		_ft_sum.setZero();
+	}
+}
+
+
+void Rover_1::_SyncFtFilters()
 {
-	Matrix<double,4,3> ft_torsors;
-	ft_torsors.row( 0 ) = *_front_ft_sensor.GetForces();
-	ft_torsors.row( 1 ) = *_front_ft_sensor.GetTorques();
-	ft_torsors.row( 2 ) = *_rear_ft_sensor.GetForces();
-	ft_torsors.row( 3 ) = *_rear_ft_sensor.GetTorques();
+	if ( _sensor_period <= 0 )
+		return;
+
+	// The part of period elapsed since the last update is flushed, so that the internal control reads the
+	// torsors up to its tick, and the clock restarts on the tick:
+	if ( _ft_sum_time > 1e-9 )
+		_ft_filter.update( _ft_sum/_ft_sum_time );
+
+	_sensor_clock = 0;
+	_ft_sum_time = 0;
+	_ft_sum.setZero();
+}
+
 
-	return ft_torsors;
+Matrix<double,4,3> Rover_1::GetFT300Torsors() const
+{
+	// Filtered forces and torques of the front sensor, then of the rear one:
+	return Map<const Matrix<double,3,4>>( _ft_filter.get_output().data() ).transpose();
 }
 
 
 void Rover_1::PrintFT300Torsors( bool endl ) const
 {
-	const Vector3d* list[] = { _front_ft_sensor.GetForces(), _front_ft_sensor.GetTorques(), _rear_ft_sensor.GetForces(), _rear_ft_sensor.GetTorques() };
-	for ( const Vector3d* vec : list )
-		for ( int j = 0 ; j < 3 ; j++ )
-			printf( "%f ", vec->coeff( j ) );
+	for ( int i = 0 ; i < 12 ; i++ )
+		printf( "%f ", _ft_filter.get_output()[i] );
 
 	if ( endl )
 	{
@@ -477,14 +617,22 @@ void Rover_1::PrintWheelTorques( bool endl ) const
 
 void Rover_1::next_step( double dt )
 {
-	_front_ft_sensor.Update();
-	_rear_ft_sensor.Update();
-	_UpdateFtFilters();
-	//_UpdateTorqueFilters();
+	UpdateKinematics();
+
+	_ft_sensors.Update();
+	_UpdateFtFilters( dt );
+	// The feedback holds the forces of the step of the world that has just been done:
+	if ( _torque_feedback )
+		_AccumulateWheelTorques();
 
 	_ic_clock += dt;
-	if ( _ic_activated && _ic_clock >= _ic_period )
+	// The tolerance absorbs the rounding of variable timesteps ending exactly on the tick:
+	if ( _ic_activated && _ic_clock >= _ic_period - 1e-6 )
 	{
+		if ( _torque_sensing )
+			_UpdateWheelTorques();
+		_SyncFtFilters();
+
 		_InternalControl( _ic_clock );
 
 		_ic_clock = 0;
@@ -493,6 +641,14 @@ void Rover_1::next_step( double dt )
 	else
 		_ic_tick = false;
 
+	// Attach the feedback of the wheel joints for the window before the next tick:
+	if ( _torque_sensing && ! _torque_feedback && GetTimeToNextTick() <= _torque_window + 1e-6 )
+		_SetWheelFeedback( true );
+
+	if ( _tire_window > 0 )
+		for ( int i = 0 ; i < NBWHEELS ; i++ )
+			static_cast<ode::Wheel*>( _wheel[i].get() )->update_contact_window();
+
 	_UpdateWheelControl();
 
 	_ApplyWheelControl();
@@ -503,6 +659,84 @@ void Rover_1::next_step( double dt )
 }
 
 
+Robot::state_ptr_t Rover_1::save_state() const
+{
+	rover_state_t* state = new rover_state_t;
+	_save_state( *state );
+
+	state->robot_speed = _robot_speed;
+	state->steering_rate = _steering_rate;
+	state->boggie_torque = _boggie_torque;
+	for ( int i = 0 ; i < NBWHEELS ; i++ )
+	{
+		state->W[i] = _W[i];
+		state->wheel_vel[i] = dJointGetHingeParam( _wheel_joint[i], dParamVel );
+		state->wheel_fmax[i] = dJointGetHingeParam( _wheel_joint[i], dParamFMax );
+		state->torque_output[i] = _torque_output[i];
+		state->torque_sum[i] = _torque_sum[i];
+	}
+	state->n_torque_samples = _n_torque_samples;
+	state->torque_feedback = _torque_feedback;
+	state->ft_sensors = _ft_sensors;
+	state->ft_filters = _ft_filter;
+	state->sensor_period = _sensor_period;
+	state->sensor_clock = _sensor_clock;
+	state->ft_sum_time = _ft_sum_time;
+	state->ft_sum = _ft_sum;
+	state->ic_activated = _ic_activated;
+	state->ic_period = _ic_period;
+	state->ic_clock = _ic_clock;
+	state->ic_tick = _ic_tick;
+	state->crawling_mode = _crawling_mode;
+
+	return state_ptr_t( state );
+}
+
+
+void Rover_1::restore_state( const state_t& robot_state )
+{
+	Robot::restore_state( robot_state );
+
+	const rover_state_t& state = static_cast<const rover_state_t&>( robot_state );
+
+	_robot_speed = state.robot_speed;
+	_steering_rate = state.steering_rate;
+	_boggie_torque = state.boggie_torque;
+	for ( int i = 0 ; i < NBWHEELS ; i++ )
+	{
+		_W[i] = state.W[i];
+		dJointSetHingeParam( _wheel_joint[i], dParamVel, state.wheel_vel[i] );
+		dJointSetHingeParam( _wheel_joint[i], dParamFMax, state.wheel_fmax[i] );
+		_torque_output[i] = state.torque_output[i];
+		_torque_sum[i] = state.torque_sum[i];
+	}
+	_n_torque_samples = state.n_torque_samples;
+	_SetWheelFeedback( _torque_sensing && state.torque_feedback );
+	_ft_sensors = state.ft_sensors;
+	// The filters saved at another sensor rate don't apply any more:
+	if ( state.sensor_period == _sensor_period )
+	{
+		_ft_filter = state.ft_filters;
+		_sensor_clock = state.sensor_clock;
+		_ft_sum_time = state.ft_sum_time;
+		_ft_sum = state.ft_sum;
+	}
+	else
+		_ResetSensorFilters();
+	_ic_activated = state.ic_activated;
+	_ic_period = state.ic_period;
+	_ic_clock = state.ic_clock;
+	_ic_tick = state.ic_tick;
+	_crawling_mode = state.crawling_mode;
+
+	UpdateKinematics();
+
+	if ( _tire_window > 0 )
+		for ( int i = 0 ; i < NBWHEELS ; i++ )
+			static_cast<ode::Wheel*>( _wheel[i].get() )->update_contact_window();
+}
+
+
 void Rover_1::_InternalControl( double delta_t )
 {
 	//PrintFT300Torsors();
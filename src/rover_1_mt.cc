@@ -39,11 +39,11 @@ vector<double> Rover_1_mt::GetState( const bool flip, const bool full ) const
 	state.push_back( flip_coeff*GetRollAngle() );
 	state.push_back( GetPitchAngle() );
 	state.push_back( flip_coeff*GetBoggieAngle() );
-	const Vector3d* list[] = { _front_ft_sensor.GetForces(), _front_ft_sensor.GetTorques(), _rear_ft_sensor.GetForces(), _rear_ft_sensor.GetTorques() };
+	Matrix<double,4,3> list = GetFT300Torsors();
 	for ( int i = 0 ; i < 4 ; i++ )
 		for ( int j = 0 ; j < 3 ; j++ )
 			if ( i != 2 || full )
-				state.push_back( ( ( i + j )%2 == 0 ? 1 : flip_coeff )*list[i]->coeff( j ) );
+				state.push_back( ( ( i + j )%2 == 0 ? 1 : flip_coeff )*list( i, j ) );
 	//for ( int i = 0 ; i < NBWHEELS ; i++ )
 		//state.push_back( _torque_output[i] );
 
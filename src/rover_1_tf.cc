@@ -11,19 +11,18 @@ namespace robot
 {
 
 
-Rover_1_tf::Rover_1_tf( Environment& env, const Vector3d& pose, const char* path_to_actor_model_dir, const int seed ) :
-                        Rover_1( env, pose ),
+Rover_1_tf::Rover_1_tf( Environment& env, const Vector3d& pose, const char* path_to_actor_model_dir, const int seed, tire_model_t tire_model,
+                        bool wheel_torque_sensing ) :
+                        Rover_1( env, pose, tire_model ),
+						_env( env ),
 						_total_reward( 0 ),
 						_exploration( false ),
+						_explore( false ),
 						_collision( false )
 {
 	_last_pos = GetPosition();
 
 
-	// Import the actor model:
-	_actor_model_ptr = TF_model<float>::ptr_t( new TF_model<float>( path_to_actor_model_dir, { 17 }, { 2 } ) );
-	
-
 	// Initialization of the random number engine:
 	if ( seed < 0 )
 	{
@@ -35,6 +34,60 @@ Rover_1_tf::Rover_1_tf( Environment& env, const Vector3d& pose, const char* path
     _normal_distribution = std::normal_distribution<double>( 0., 1. );
     _uniform_distribution = std::uniform_real_distribution<double>( -1., 1. );
 
+	if ( wheel_torque_sensing )
+		Rover_1::SetWheelTorqueSensing( true );
+	_SetStateScaling();
+
+
+	// Import the actor model, for the dimension of the state:
+	LoadActor( path_to_actor_model_dir );
+
+
+	// Detect if the motor bulks touch an obstacle, from the contacts actually generated at each step:
+	int ground_group = env.get_collision_group_id( "ground" );
+	dBodyID front_fork = _front_fork->get_body();
+	dBodyID rear_fork = _rear_fork->get_body();
+	_contact_listener = env.add_contact_listener( [this,ground_group,front_fork,rear_fork]( const contact_event_t* events, int n )
+	{
+		for ( int i = 0 ; i < n ; i++ )
+			if ( ( events[i].body_1 == front_fork || events[i].body_1 == rear_fork ) && events[i].group_2 == ground_group
+			  || ( events[i].body_2 == front_fork || events[i].body_2 == rear_fork ) && events[i].group_1 == ground_group )
+			{
+				_collision = true;
+				return;
+			}
+	} );
+}
+
+
+Rover_1_tf::~Rover_1_tf()
+{
+	_env.remove_contact_listener( _contact_listener );
+}
+
+
+void Rover_1_tf::LoadActor( const char* path_to_actor_model_dir )
+{
+	_actor_model_dir = path_to_actor_model_dir;
+	_actor_model_ptr = TF_model<float>::ptr_t( new TF_model<float>( path_to_actor_model_dir, { GetStateDim() }, { 2 } ) );
+}
+
+
+void Rover_1_tf::SetWheelTorqueSensing( bool enable, double window )
+{
+	bool reload = ( enable != IsWheelTorqueSensing() );
+	Rover_1::SetWheelTorqueSensing( enable, window );
+
+	_SetStateScaling();
+
+	// The actor takes the new state:
+	if ( reload )
+		LoadActor( _actor_model_dir.c_str() );
+}
+
+
+void Rover_1_tf::_SetStateScaling()
+{
 	// State scaling before feeding the neural network:
 	_state_scaling = { 90, 45, 25, 25, 45 };
 	for ( int i = 0 ; i < 2 ; i++ )
@@ -45,33 +98,62 @@ Rover_1_tf::Rover_1_tf( Environment& env, const Vector3d& pose, const char* path
 			_state_scaling.push_back( 30 );
 	}
 
+	// The wheel torques, scaled by the maximal torque of the motors:
+	if ( IsWheelTorqueSensing() )
+		for ( int i = 0 ; i < NBWHEELS ; i++ )
+			_state_scaling.push_back( 25 );
+}
+
 
-	// Assign a callback to detect if the motor bulks touch an obstacle:
-	std::function<void(collision_feature*)> collision_callback = [&]( collision_feature* collided_object )
+void Rover_1_tf::Reset( const int seed )
+{
+	if ( seed >= 0 )
+		_rd_gen.seed( seed );
+
+	_last_pos = GetPosition();
+	_last_state.clear();
+	_experience.clear();
+	_total_reward = 0;
+	_explore = false;
+	_collision = false;
+}
+
+
+p::list ExperienceToList( const std::vector<Transition>& experience )
+{
+	p::list list;
+
+	for ( const Transition& transition : experience )
 	{
-		if ( collided_object != nullptr && strcmp( collided_object->group, "ground" ) == 0 )
-			_collision = true;
-	};
-	_front_fork->set_all_collision_callback( collision_callback );
-	_rear_fork->set_all_collision_callback( collision_callback );
+		p::list state, next_state;
+		for ( double value : transition.state )
+			state.append( value );
+		for ( double value : transition.next_state )
+			next_state.append( value );
+
+		list.append( p::make_tuple( state, p::make_tuple( transition.action[0], transition.action[1] ), transition.reward, transition.done, next_state ) );
+	}
+
+	return list;
 }
 
 
-p::list Rover_1_tf::GetState() const
+std::vector<double> Rover_1_tf::GetState() const
 {
-	p::list state;
-
-	state.append( GetDirection() );
-	state.append( GetSteeringTrueAngle() );
-	state.append( GetRollAngle() );
-	state.append( GetPitchAngle() );
-	state.append( GetBoggieAngle() );
-	const Vector3d* list[] = { _front_ft_sensor.GetForces(), _front_ft_sensor.GetTorques(), _rear_ft_sensor.GetForces(), _rear_ft_sensor.GetTorques() };
+	std::vector<double> state;
+
+	state.push_back( GetDirection() );
+	state.push_back( GetSteeringTrueAngle() );
+	state.push_back( GetRollAngle() );
+	state.push_back( GetPitchAngle() );
+	state.push_back( GetBoggieAngle() );
+	Matrix<double,4,3> list = GetFT300Torsors();
 	for ( int i = 0 ; i < 4 ; i++ )
 		for ( int j = 0 ; j < 3 ; j++ )
-			state.append( list[i]->coeff( j ) );
-	//for ( int i = 0 ; i < NBWHEELS ; i++ )
-		//state.append( _torque_output[i] );
+			state.push_back( list( i, j ) );
+	if ( IsWheelTorqueSensing() )
+		for ( int i = 0 ; i < NBWHEELS ; i++ )
+			state.push_back( _torque_output[i] );
 
 	return state;
 }
@@ -115,21 +197,21 @@ void Rover_1_tf::_InternalControl( double delta_t )
 	_total_reward += reward;
 
 	// Get the current state of the robot:
-	p::list current_state = GetState();
+	std::vector<double> current_state = GetState();
 
 	// Store the latest experience:
-	if ( p::len( _last_state ) > 0 )
-		_experience.append( p::make_tuple( _last_state, p::make_tuple( _steering_rate, _boggie_torque ), reward, false, current_state ) );
+	if ( ! _last_state.empty() )
+		_experience.push_back( { _last_state, { _steering_rate, _boggie_torque }, reward, false, current_state } );
 
 
 #ifdef PRINT_TRANSITIONS
-	if ( p::len( _last_state ) > 0 )
+	if ( ! _last_state.empty() )
 	{
-		for ( int i = 0 ; i < p::len( _last_state ) ; i++ )
-			printf( "%f ", float( p::extract<float>( _last_state[i] ) ) );
+		for ( double value : _last_state )
+			printf( "%f ", float( value ) );
 		printf( "%f %f", _steering_rate, _boggie_torque );
-		for ( int i = 0 ; i < p::len( current_state ) ; i++ )
-			printf( " %f", float( p::extract<float>( current_state[i] ) ) );
+		for ( double value : current_state )
+			printf( " %f", float( value ) );
 		printf( "\n" );
 		fflush( stdout );
 	}
@@ -140,8 +222,8 @@ void Rover_1_tf::_InternalControl( double delta_t )
 
 	// Setup the inputs:
 	std::vector<float> input_vector;
-	for ( int i = 0 ; i < p::len( current_state ) ; i++ )
-		input_vector.push_back( float( p::extract<float>( current_state[i] ) )/_state_scaling[i] );
+	for ( int i = 0 ; i < current_state.size() ; i++ )
+		input_vector.push_back( float( current_state[i] )/_state_scaling[i] );
 
 
 
@@ -165,19 +247,17 @@ void Rover_1_tf::_InternalControl( double delta_t )
 
 	// E-greedy exploration:
 
-	static bool explore;
-
 	double draw = ( _uniform_distribution( _rd_gen ) + 1 )/2;
-	if ( _exploration && ( ! explore && draw > 0.8 || explore && draw > 0.7 ) )
+	if ( _exploration && ( ! _explore && draw > 0.8 || _explore && draw > 0.7 ) )
 	{
-		explore = ! explore;
-		if ( explore )
+		_explore = ! _explore;
+		if ( _explore )
 		{
 			_steering_rate = _uniform_distribution( _rd_gen )*steering_max_vel;
 			_boggie_torque = _uniform_distribution( _rd_gen )*boggie_max_torque;
 		}
 	}
-	if ( !_exploration || ! explore )
+	if ( !_exploration || ! _explore )
 	{
 		std::vector<std::vector<float>> output_vectors = _actor_model_ptr->infer( { input_vector } );
 
@@ -188,8 +268,8 @@ void Rover_1_tf::_InternalControl( double delta_t )
 
 
 #ifdef PRINT_STATE_AND_ACTIONS
-	for ( int i = 0 ; i < p::len( current_state ) ; i++ )
-		printf( "%f ", float( p::extract<float>( current_state[i] ) ) );
+	for ( double value : current_state )
+		printf( "%f ", float( value ) );
 	printf( "%f %f\n", _steering_rate, _boggie_torque );
 	fflush( stdout );
 #endif
@@ -11,32 +11,65 @@ namespace robot
 {
 
 
+// Experience is stored without any Python object so that the rover can be simulated outside the main thread:
+typedef struct Transition
+{
+	std::vector<double> state;
+	double action[2];
+	double reward;
+	bool done;
+	std::vector<double> next_state;
+} Transition;
+
+boost::python::list ExperienceToList( const std::vector<Transition>& experience );
+
+
 class Rover_1_tf : public Rover_1
 {
 	public:
 
-	Rover_1_tf( ode::Environment& env, const Eigen::Vector3d& pose, const char* path_to_actor_model_dir, const int seed = -1 );
+	Rover_1_tf( ode::Environment& env, const Eigen::Vector3d& pose, const char* path_to_actor_model_dir, const int seed = -1,
+	            ode::tire_model_t tire_model = ode::SPHERES_TIRE, bool wheel_torque_sensing = false );
+	~Rover_1_tf();
+
+	std::vector<double> GetState() const;
+	/// 17, plus the 4 wheel torques with the wheel torque sensing:
+	inline int GetStateDim() const { return _state_scaling.size(); }
+
+	/// Load the TensorFlow model of the actor.
+	void LoadActor( const char* path_to_actor_model_dir );
+
+	/// The actor is reloaded with the input dimension of the new state.
+	virtual void SetWheelTorqueSensing( bool enable, double window = 0.05 );
 
-	boost::python::list GetState() const;
+	/// Clear the experience and the reward to start a new episode, once the state of the rover has been
+	/// restored. A non-negative seed reinitializes the random number engine.
+	void Reset( const int seed = -1 );
 
 	inline void SetExploration( bool expl ) { _exploration = expl; }
 
-	inline boost::python::list GetExperience() const { return _experience; }
+	inline const std::vector<Transition>& GetExperience() const { return _experience; }
+	inline std::vector<Transition>& GetExperience() { return _experience; }
 
 	inline double GetTotalReward() const { return _total_reward; }
 
 	protected:
 
 	double _ComputeReward( double delta_t );
+	void _SetStateScaling();
 
 	virtual void _InternalControl( double delta_t );
 
+	ode::Environment& _env;
+	int _contact_listener;
 	TF_model<float>::ptr_t _actor_model_ptr;
+	std::string _actor_model_dir;
 	Eigen::Vector3d _last_pos;
-	boost::python::list _last_state;
-	boost::python::list _experience;
+	std::vector<double> _last_state;
+	std::vector<Transition> _experience;
 	double _total_reward;
 	bool _exploration;
+	bool _explore;
     std::mt19937 _rd_gen;
     std::normal_distribution<double> _normal_distribution;
     std::uniform_real_distribution<double> _uniform_distribution;
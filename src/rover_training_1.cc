@@ -18,6 +18,23 @@
 **
 ** Fourth argument (optional):
 ** Starting delay of the control.
+**
+** Fifth argument (optional):
+** torques: Append the wheel torques to the state, for an actor taking 21 inputs.
+**
+** As a module, trial_batch( path, n ) runs n independent trials in parallel on a pool
+** of worker threads (one per hardware thread by default, see set_threads) and returns
+** their concatenated experience.
+**
+** The module also exports the class Session( path, exploration = False, wheel_torque_sensing = False ), which keeps the
+** world, the rover and its actor model between the episodes:
+** reset( seed, orientation, offset ), reset_random(), run_episode(), reload_actor( path ) and
+** set_adaptive_timestep( max_multiple ) to let the timestep grow on calm phases of the episodes,
+** use_mesh_collisions() to collide the chassis through its meshes instead of boxes,
+** set_sensor_rate( rate ) to update the filtered observations at a lower rate than the physics
+** and set_wheel_torque_sensing( enable ) to append the torques of the wheels to the state.
+** Each worker of trial_batch reuses its own session in the same way. The module function
+** set_wheel_torque_sensing( enable ) applies to the sessions of trial, eval and trial_batch.
 */
 
 #include "ode/environment.hh"
@@ -25,8 +42,10 @@
 #include "rover_tf.hh"
 #include "ode/box.hh"
 #include "ode/heightfield.hh"
+#include "ode/terrain_pool.hh"
 #include "renderer/sim_loop.hh"
 #include "renderer/osg_text.hh"
+#include "ode/rollout_pool.hh"
 #include <boost/python.hpp>
 #include <random>
 #include <csignal>
@@ -35,40 +54,305 @@
 #define DEFAULT_PATH_TO_MODEL_DIR "../training_data/Rt05/actor"
 
 
+// Wheel torque sensing of the rovers created by the executable and the module functions
+// (see set_wheel_torque_sensing):
+bool wheel_torque_sensing( false );
+
+
 namespace p = boost::python;
 
 
-p::list simulation( const char* option = "", const char* path_to_model_dir = DEFAULT_PATH_TO_MODEL_DIR, int argc = 0, char* argv[] = nullptr )
+// Scene of the trials, kept alive across the episodes so that each episode only restores
+// the state of the world after the warm-up instead of rebuilding and re-simulating it:
+class Session
 {
-	// Uniform random generator:
-	std::random_device rd;
-	std::mt19937 gen( rd() );
-	std::uniform_real_distribution<double> uniform( -1, 1 );
+	public:
 
+	Session( const char* path_to_model_dir = DEFAULT_PATH_TO_MODEL_DIR, bool exploration = false, bool wheel_torque_sensing = false );
 
-	// [ Dynamic environment ]
+	/// Restore the state of the world at the end of the warm-up with a step oriented by orientation (in degrees)
+	/// and the internal control starting offset seconds later, offset being at least -max_IC_offset. A negative
+	/// seed draws a random one.
+	void Reset( int seed, double orientation, double offset );
+	/// Reset with a scenario drawn at random, as for the training trials.
+	void ResetRandom();
 
-	dInitODE();
-	// Set the global friction coefficient:
-	ode::Environment env( 0.5 );
+	/// Simulate an episode from the last reset and return its experience.
+	std::vector<robot::Transition> RunEpisode( renderer::OsgVisitor* display_ptr = nullptr, bool capture = false );
+
+	inline void ReloadActor( const char* path_to_model_dir ) { _robot.LoadActor( path_to_model_dir ); }
+
+	/// Let the timestep grow up to max_multiple times the base timestep when the dynamics are calm
+	/// (1 restores the fixed timestep).
+	inline void SetAdaptiveTimestep( unsigned int max_multiple ) { _max_multiple = max_multiple; }
 
+	/// Collide the chassis of the rover through its meshes (see Rover_1::UseMeshCollisions).
+	inline void UseMeshCollisions() { _robot.UseMeshCollisions(); }
+
+	/// Update the filtered observations of the rover at rate Hz instead of every step (see Rover_1::SetSensorRate).
+	inline void SetSensorRate( double rate ) { _robot.SetSensorRate( rate ); }
+
+	/// Append the wheel torques to the state of the rover (see Rover_1::SetWheelTorqueSensing), which
+	/// requires an actor taking 21 inputs.
+	inline void SetWheelTorqueSensing( bool enable ) { _robot.SetWheelTorqueSensing( enable ); }
+
+	/// Print the simulated time of the episodes on stderr (default), which garbles it with several sessions in parallel.
+	inline void SetPrintTime( bool print_time ) { _print_time = print_time; }
+
+	inline robot::Rover_1_tf& GetRobot() { return _robot; }
+	/// Duration of the last episode:
+	inline double GetTime() const { return _time; }
+	void accept( ode::ConstVisitor& v ) const;
+
+	// [ Simulation rules ]
+
+	// Cruise speed of the robot:
+	static constexpr float speedf = 0.04;
+	// Time to reach cruise speed:
+	static constexpr float term = 0.5;
+	// Timeout of the simulation:
+	static constexpr float timeout = 60;
+	// Maximum distance to travel ahead:
+	static constexpr float x_goal = 1.5;
+	// Maximum lateral deviation permitted:
+	static constexpr float y_max = 0.6;
+	// Height of the step:
+	static constexpr float step_height = 0.105*2;
+	// Start of the internal control, which varies by up to max_IC_offset between the episodes:
+	static constexpr double IC_delay = 1;
+	static constexpr double max_IC_offset = 0.25;
+	// The episodes start from a snapshot taken at the earliest start of the internal control. Nothing before
+	// it depends on the episode: the rover ramps its speed up and doesn't reach the step.
+	static constexpr double warmup_time = IC_delay - max_IC_offset;
+
+	// Levels of the error indicators requiring the base timestep:
+	static constexpr double max_contact_depth = 0.002; // m
+	static constexpr double max_ft_extension_rate = 0.01; // m/s
+
+	protected:
+
+	/// Step oriented by orientation (in degrees) and its continuation:
+	void _PlaceTerrain( double orientation );
+
+	/// Ramp the speed of the rover up to speedf:
+	void _RampSpeed( float timestep );
+
+	std::mt19937 _gen;
+	std::uniform_real_distribution<double> _uniform;
+
+	// [ Dynamic environment ]
+	ode::Environment _env;
 
 	// [ Robot ]
+	robot::Rover_1_tf _robot;
+
+	// [ Terrain ]
+	ode::Terrain_pool _terrain;
 
-	robot::Rover_1_tf robot( env, Eigen::Vector3d( 0, 0, 0 ), path_to_model_dir );
-	robot.SetCrawlingMode( true );
-	robot.SetCmdPeriod( 0.5 );
+	ode::Environment::snapshot_t _env_snapshot;
+	robot::Robot::state_ptr_t _robot_snapshot;
+
+	// Speed of the rover, stored in the snapshot with the world:
+	float _speed;
+	float _speed_snapshot;
+
+	// Duration before starting the internal control:
+	double _IC_start;
+	double _time;
+	unsigned int _max_multiple;
+	int _last_contact_count;
+	bool _print_time;
+};
+
+
+// Set the global friction coefficient to 0.5:
+Session::Session( const char* path_to_model_dir, bool exploration, bool wheel_torque_sensing ) :
+                  _gen( std::random_device()() ), _uniform( -1, 1 ),
+                  _env( 0.5 ),
+                  _robot( _env, Eigen::Vector3d( 0, 0, 0 ), path_to_model_dir, -1, ode::SPHERES_TIRE, wheel_torque_sensing ),
+                  _terrain( _env, "ground" ),
+                  _speed( 0 ), _speed_snapshot( 0 ), _IC_start( IC_delay ), _time( 0 ), _max_multiple( 1 ), _last_contact_count( 0 ), _print_time( true )
+{
+	_robot.SetCrawlingMode( true );
+	_robot.SetCmdPeriod( 0.5 );
 //#ifdef EXE
-	//robot.SetCmdPeriod( 0.1 );
+	//_robot.SetCmdPeriod( 0.1 );
 //#endif
-	robot.DeactivateIC();
-	if ( strncmp( option, "trial", 6 ) == 0 || strncmp( option, "explore", 8 ) == 0 )
-		robot.SetExploration( true );
+	_robot.DeactivateIC();
+	_robot.SetExploration( exploration );
+	// The geoms of the rover are not tested against each other:
+	_robot.set_own_space( _env );
 
+	// A tire sphere touches the terrain at a single point, and a face of the other bodies at its corners:
+	_env.set_contact_budget( dSphereClass, 1 );
+	_env.set_contact_budget( dBoxClass, 4 );
+	_env.set_contact_budget( dCylinderClass, 4 );
 
-	// [ Terrain ]
+	_PlaceTerrain( 0 );
+
+	// Warm-up shared by all the episodes:
+	const float timestep( 0.001 );
+	for ( long i = 0 ; i < lround( warmup_time/timestep ) ; i++ )
+	{
+		_RampSpeed( timestep );
+		_env.next_step( timestep );
+		_robot.next_step( timestep );
+	}
+
+	_env.save_state( _env_snapshot );
+	_robot_snapshot = _robot.save_state();
+	_speed_snapshot = _speed;
+}
+
+
+void Session::Reset( int seed, double orientation, double offset )
+{
+	if ( offset < -max_IC_offset )
+		throw std::runtime_error( "The internal control can't start before the end of the warm-up" );
+
+	if ( seed >= 0 )
+		_gen.seed( seed );
 
-	int direction = 1;
+	_env.restore_state( _env_snapshot );
+	_robot.restore_state( *_robot_snapshot );
+	_robot.Reset( seed );
+	_speed = _speed_snapshot;
+
+	_PlaceTerrain( orientation );
+	_IC_start = IC_delay + offset;
+	_time = warmup_time;
+}
+
+
+void Session::_RampSpeed( float timestep )
+{
+	if ( fabs( _speed ) <= fabs( speedf ) )
+	{
+		_speed += speedf/term*timestep;
+		_robot.SetRobotSpeed( _speed );
+	}
+}
+
+
+void Session::_PlaceTerrain( double orientation )
+{
+	_terrain.begin();
+	_terrain.add_box( Eigen::Vector3d( 1, 0, step_height/2 ), 1, 3, step_height ).set_rotation( 0, 0, orientation*M_PI/180 );
+	_terrain.add_box( Eigen::Vector3d( 2, 0, step_height/2 ), 2, 3, step_height );
+	_terrain.end();
+}
+
+
+void Session::ResetRandom()
+{
+	// Maximum angle of the step:
+	float max_rot( 5 );
+	double orientation = max_rot*_uniform( _gen );
+	double offset = max_IC_offset*_uniform( _gen );
+	Reset( -1, orientation, offset );
+}
+
+
+void Session::accept( ode::ConstVisitor& v ) const
+{
+	_robot.accept( v );
+	_terrain.accept( v );
+}
+
+
+std::vector<robot::Transition> Session::RunEpisode( renderer::OsgVisitor* display_ptr, bool capture )
+{
+	std::function<bool(float,double)> step_function = [&]( float timestep, double time )
+	{
+		_RampSpeed( timestep );
+
+		if ( ! _robot.IsICActivated() && time >= _IC_start )
+			_robot.ActivateIC();
+
+		_env.next_step( timestep );
+		_robot.next_step( timestep );
+
+		// If the robot has reached the goal, is out of track or has tipped over, end the simulation:
+		if ( time >= timeout || fabs( _robot.GetPosition().y() ) >= y_max || fabs( _robot.GetPosition().x() ) >= x_goal || _robot.IsUpsideDown() )
+			return true;
+
+		return false;
+	};
+
+
+	// [ Simulation loop ]
+
+	Sim_loop sim( 0.001, display_ptr, _print_time, 0 );
+	// The episode resumes from the snapshot of the warm-up:
+	sim.set_time( warmup_time );
+
+	if ( _max_multiple > 1 )
+	{
+		_last_contact_count = _env.get_contact_count();
+
+		// Small steps are needed when contacts appear or vanish, when they are deep, when the springs of
+		// the force-torque sensors move fast or when the boggie joint is on its stops:
+		std::function<double(void)> error = [this]()
+		{
+			double error = std::max( _env.get_max_contact_depth()/max_contact_depth, _robot.GetFtExtensionRate()/max_ft_extension_rate );
+			if ( _env.get_contact_count() != _last_contact_count || _robot.IsBoggieAtLimit() )
+				error = 2;
+			_last_contact_count = _env.get_contact_count();
+			return error;
+		};
+
+		// The control ticks and its activation must be reached exactly:
+		std::function<double(void)> horizon = [this,&sim]()
+		{
+			double horizon = _robot.GetTimeToNextTick();
+			if ( ! _robot.IsICActivated() )
+				horizon = std::min( horizon, std::max( 0., _IC_start - sim.get_time() ) );
+			return horizon;
+		};
+
+		sim.set_adaptive_timestep( _max_multiple, error, horizon );
+	}
+
+	// Record screenshots of the simulation:
+	if ( capture )
+		sim.start_captures();
+
+	sim.loop( step_function );
+	_time = sim.get_time();
+
+
+	// Fetch the stored experience from the trial:
+	std::vector<robot::Transition> experience;
+	experience.swap( _robot.GetExperience() );
+
+	if ( ! experience.empty() )
+	{
+		// Penalise if the rover has gone too far sideway:
+		if ( fabs( _robot.GetPosition().y() ) >= y_max )
+			experience.back().reward -= 2;
+		// Penalise if the rover has tipped over:
+		else if ( _robot.IsUpsideDown() )
+			experience.back().reward -= 5;
+
+		experience.back().done = true;
+	}
+
+	return experience;
+}
+
+
+std::vector<robot::Transition> simulation( const char* option = "", const char* path_to_model_dir = DEFAULT_PATH_TO_MODEL_DIR, int argc = 0, char* argv[] = nullptr )
+{
+	Session session( path_to_model_dir, strncmp( option, "trial", 6 ) == 0 || strncmp( option, "explore", 8 ) == 0, wheel_torque_sensing );
+	robot::Rover_1_tf& robot = session.GetRobot();
+
+	// Uniform random generator (one per trial, so that the scenario of each trial is drawn independently):
+	std::random_device rd;
+	std::mt19937 gen( rd() );
+	std::uniform_real_distribution<double> uniform( -1, 1 );
+
+
+	// [ Terrain ]
 
 	// Orientation angle of the step:
 	double orientation;
@@ -87,63 +371,20 @@ p::list simulation( const char* option = "", const char* path_to_model_dir = DEF
 		float max_rot( 5 );
 		orientation = max_rot*uniform( gen );
 	}
-	float step_height( 0.105*2 );
-	ode::Box step( env, Eigen::Vector3d( direction*1, 0, step_height/2 ), 1, 1, 3, step_height, false );
-	step.set_rotation( 0, 0, orientation*M_PI/180 );
-	step.fix();
-	step.set_collision_group( "ground" );
-
-	ode::Box step_c( env, Eigen::Vector3d( direction*2, 0, step_height/2 ), 1, 2, 3, step_height, false );
-	step_c.fix();
-	step_c.set_collision_group( "ground" );
-
-
-	// [ Simulation rules ]
 
-	// Cruise speed of the robot:
-	float speedf( direction*0.04 );
-	// Time to reach cruise speed:
-	float term( 0.5 );
-	// Duration before starting the internal control:
-	float IC_start( 1 );
+	// Starting offset of the internal control:
+	double offset( 0 );
 	if ( argc > 4 )
 	{
 		char* endptr;
-		IC_start += strtod( argv[4], &endptr );
+		offset = strtod( argv[4], &endptr );
 		if ( *endptr != '\0' )
 			throw std::runtime_error( std::string( "Invalide starting offset: " ) + std::string( argv[4] ) );
 	}
 	else if ( strncmp( option, "trial", 6 ) == 0 )
-		IC_start += 0.25*uniform( gen );
-	// Timeout of the simulation:
-	float timeout( 60 );
-	// Maximum distance to travel ahead:
-	float x_goal( 1.5 );
-	// Maximum lateral deviation permitted:
-	float y_max( 0.6 );
+		offset = Session::max_IC_offset*uniform( gen );
 
-	float speed = 0;
-
-	std::function<bool(float,double)> step_function = [&]( float timestep, double time )
-	{
-		if ( fabs( speed ) <= fabs( speedf ) )
-		{
-			speed += speedf/term*timestep;
-			robot.SetRobotSpeed( speed );
-		}
-
-		if ( ! robot.IsICActivated() && time >= IC_start )
-			robot.ActivateIC();
-
-		env.next_step( timestep );
-		robot.next_step( timestep );
-
-		// If the robot has reached the goal, is out of track or has tipped over, end the simulation:
-		if ( time >= timeout || fabs( robot.GetPosition().y() ) >= y_max || fabs( robot.GetPosition().x() ) >= x_goal || robot.IsUpsideDown() )
-			return true;
-
-		return false;
-	};
+	session.Reset( -1, orientation, offset );
 
 
 	// [ Display ]
@@ -161,9 +402,7 @@ p::list simulation( const char* option = "", const char* path_to_model_dir = DEF
 		//display_ptr->disable_shadows();
 		display_ptr->get_keh()->set_pause();
 
-		robot.accept( *display_ptr );
-		step.accept( *display_ptr );
-		step_c.accept( *display_ptr );
+		session.accept( *display_ptr );
 
 		robot::RoverControl* keycontrol = new robot::RoverControl( &robot, display_ptr->get_viewer() );
 
@@ -190,37 +429,18 @@ p::list simulation( const char* option = "", const char* path_to_model_dir = DEF
 
 	// [ Simulation loop ]
 
-	Sim_loop sim( 0.001, display_ptr, true, 0 );
-
-	// Record screenshots of the simulation:
-	if ( strncmp( option, "capture", 8 ) == 0 )
-		sim.start_captures();
-
-	sim.loop( step_function );
+	std::vector<robot::Transition> experience = session.RunEpisode( display_ptr, strncmp( option, "capture", 8 ) == 0 );
 
 
 	// Print the result of the trial:
 	if ( strncmp( option, "trial", 6 ) != 0 )
 	{
 		printf( "%s t %6.3f | x %5.3f | y %+6.3f | Rmoy %7.3f\n",
-		( fabs( robot.GetPosition().x() ) >= x_goal ? "\033[1;32m[Success]\033[0;39m" : "\033[1;31m[Failure]\033[0;39m" ),
-		sim.get_time(), robot.GetPosition().x(), robot.GetPosition().y(), robot.GetTotalReward()/sim.get_time() );
+		( fabs( robot.GetPosition().x() ) >= Session::x_goal ? "\033[1;32m[Success]\033[0;39m" : "\033[1;31m[Failure]\033[0;39m" ),
+		session.GetTime(), robot.GetPosition().x(), robot.GetPosition().y(), robot.GetTotalReward()/session.GetTime() );
 		fflush( stdout );
 	}
 
-
-	// Fetch the stored experience from the trial:
-	p::list experience = robot.GetExperience();
-
-	// Penalise if the rover has gone too far sideway:
-	if ( fabs( robot.GetPosition().y() ) >= y_max )
-		experience[-1] = p::make_tuple( experience[-1][0], experience[-1][1], experience[-1][2] - 2, true, experience[-1][4] );
-	// Penalise if the rover has tipped over:
-	else if ( robot.IsUpsideDown() )
-		experience[-1] = p::make_tuple( experience[-1][0], experience[-1][1], experience[-1][2] - 5, true, experience[-1][4] );
-	else
-		experience[-1] = p::make_tuple( experience[-1][0], experience[-1][1], experience[-1][2], true, experience[-1][4] );
-
 	return experience;
 }
 
@@ -230,10 +450,15 @@ int main( int argc, char* argv[] )
 	Py_Initialize();
 	signal( SIGINT, SIG_DFL );
 
+	dInitODE();
+
 	const char* path_to_model_dir = DEFAULT_PATH_TO_MODEL_DIR;
 	if ( argc > 2 && strncmp( argv[2], "--", 3 ) != 0 )
 		path_to_model_dir = argv[2];
 
+	if ( argc > 5 && strncmp( argv[5], "torques", 8 ) == 0 )
+		wheel_torque_sensing = true;
+
 	simulation( argc > 1 ? argv[1] : "display", path_to_model_dir, argc, argv );
 
 	return 0;
@@ -242,7 +467,7 @@ int main( int argc, char* argv[] )
 
 p::list trial( const char* path_to_model_dir )
 {
-	return simulation( "trial", path_to_model_dir );
+	return robot::ExperienceToList( simulation( "trial", path_to_model_dir ) );
 }
 
 
@@ -252,10 +477,106 @@ void eval( const char* path_to_model_dir )
 }
 
 
+// Release the Python GIL while the worker threads are simulating:
+class Release_GIL
+{
+	public:
+	Release_GIL() : _state( PyEval_SaveThread() ) {}
+	~Release_GIL() { PyEval_RestoreThread( _state ); }
+	protected:
+	PyThreadState* _state;
+};
+
+
+ode::Rollout_pool::ptr_t rollout_pool;
+// Scene of each worker of the pool, created at its first trial:
+std::vector<boost::shared_ptr<Session>> worker_sessions;
+
+
+void set_threads( unsigned int n_threads )
+{
+	worker_sessions.clear();
+	rollout_pool.reset();
+	rollout_pool = ode::Rollout_pool::ptr_t( new ode::Rollout_pool( n_threads ) );
+	worker_sessions.resize( rollout_pool->size() );
+}
+
+
+void set_wheel_torque_sensing( bool enable )
+{
+	wheel_torque_sensing = enable;
+	for ( boost::shared_ptr<Session>& session : worker_sessions )
+		if ( session )
+			session->SetWheelTorqueSensing( enable );
+}
+
+
+p::list trial_batch( const char* path_to_model_dir, unsigned int n_trials )
+{
+	if ( ! rollout_pool )
+		set_threads( 0 );
+
+	std::string model_dir( path_to_model_dir );
+	std::vector<std::vector<robot::Transition>> experiences( n_trials );
+	// The actor of each worker is reloaded once per batch:
+	std::vector<char> actor_loaded( worker_sessions.size(), 0 );
+	{
+		Release_GIL release;
+		rollout_pool->run( n_trials, [&]( unsigned int trial_index, unsigned int worker_index )
+		{
+			boost::shared_ptr<Session>& session = worker_sessions[worker_index];
+			if ( ! session )
+			{
+				session = boost::shared_ptr<Session>( new Session( model_dir.c_str(), true, wheel_torque_sensing ) );
+				session->SetPrintTime( false );
+			}
+			else if ( ! actor_loaded[worker_index] )
+				session->ReloadActor( model_dir.c_str() );
+			actor_loaded[worker_index] = 1;
+
+			session->ResetRandom();
+			experiences[trial_index] = session->RunEpisode();
+		} );
+	}
+
+	p::list experience;
+	for ( const std::vector<robot::Transition>& trial_experience : experiences )
+		experience.extend( robot::ExperienceToList( trial_experience ) );
+
+	return experience;
+}
+
+
+p::list run_episode( Session& session )
+{
+	std::vector<robot::Transition> experience;
+	{
+		Release_GIL release;
+		experience = session.RunEpisode();
+	}
+	return robot::ExperienceToList( experience );
+}
+
+
 BOOST_PYTHON_MODULE( rover_training_1_module )
 {
 	signal( SIGINT, SIG_DFL );
 
+	dInitODE();
+
     p::def( "trial", trial );
+    p::def( "trial_batch", trial_batch );
+    p::def( "set_threads", set_threads );
+    p::def( "set_wheel_torque_sensing", set_wheel_torque_sensing );
     p::def( "eval", eval );
+
+	p::class_<Session, boost::noncopyable>( "Session", p::init<const char*, p::optional<bool,bool>>() )
+		.def( "reset", &Session::Reset )
+		.def( "reset_random", &Session::ResetRandom )
+		.def( "run_episode", run_episode )
+		.def( "reload_actor", &Session::ReloadActor )
+		.def( "set_adaptive_timestep", &Session::SetAdaptiveTimestep )
+		.def( "use_mesh_collisions", &Session::UseMeshCollisions )
+		.def( "set_sensor_rate", &Session::SetSensorRate )
+		.def( "set_wheel_torque_sensing", &Session::SetWheelTorqueSensing );
 }